@@ -0,0 +1,562 @@
+#ifndef ANTIALIASEDKERNELS_H_INCLUDED
+#define ANTIALIASEDKERNELS_H_INCLUDED
+
+#include "Distortion.h"
+#include "SimdVector.h"
+
+#include <algorithm>
+
+/**
+    Antiderivative anti-aliasing (ADAA) of the nonlinearities.
+
+    Instead of sampling the curve f at each input, first order ADAA outputs the
+    mean of f between consecutive inputs, (F1(x[n]) - F1(x[n-1])) / (x[n] - x[n-1])
+    with F1 the antiderivative of f. This is f seen through a one sample box
+    filter, which suppresses aliasing at the base rate. Second order ADAA does
+    the same with the second antiderivative F2 and a triangular filter, it
+    rejects more aliasing and dulls the top octave a little more.
+
+    The division is ill-conditioned when consecutive inputs are nearly equal,
+    then the curve is evaluated at the midpoint instead, which is the limit of
+    the quotient. Everything is computed in double, the arctangent and its
+    logarithm through vatanDouble and vlogDouble.
+
+    First order ADAA delays by half a sample, second order by one sample. The
+    dry signal is delayed to match, and the modes without a closed form
+    antiderivative (and bypass) evaluate the curve at the delayed input, so
+    the delay doesn't depend on the mode.
+
+    The kernels are stateful, they read and update the last inputs of each
+    lane, and process frames of interleaved lanes like
+    Distortion::processInterleaved. A sample's quotient only depends on its
+    own input and the last ones of its lane, so a chunk of the block is
+    evaluated a double vector at a time across frames and lanes alike. The
+    fallbacks of the ill-conditioned quotients only run for the vectors with
+    a lane that needs them. The delayed modes run the float kernels on the
+    delayed input.
+
+    Only included by DistortionKernels.h, so it's built once per instruction
+    set along with the other kernels.
+ */
+namespace DistortionKernels
+{
+namespace
+{
+    /*  The curves with their first and second antiderivatives, for doubles
+        and double vectors.
+
+        Apart from the square law, the curves are functions of u = drive * x.
+        The ADAA quotients are the same whether they're taken over x or u, so
+        they're computed over u and the drive only scales the inputs.
+     */
+
+    // Cubic soft clipping, constant beyond |u| = 1
+    struct SoftClipAdaa
+    {
+        const double scale;
+
+        explicit SoftClipAdaa(const Distortion::Controls& controls)
+        : scale(controls.drive) {}
+
+        template <typename T>
+        T f(T u) const
+        {
+            return vselect(u < T(-1.), T(-2. / 3.), vselect(u > T(1.), T(2. / 3.), u - u * u * u / T(3.)));
+        }
+
+        template <typename T>
+        T F1(T u) const
+        {
+            const T a = vabs(u);
+            return vselect(a > T(1.), T(2. / 3.) * a - T(0.25), u * u / T(2.) - u * u * u * u / T(12.));
+        }
+
+        template <typename T>
+        T F2(T u) const
+        {
+            const T a = vabs(u);
+            const T outside = u * u / T(3.) - a / T(4.) + T(1. / 15.);
+            return vselect(a > T(1.), vselect(u < T(0.), -outside, outside),
+                           u * u * u / T(6.) - u * u * u * u * u / T(60.));
+        }
+    };
+
+    struct ArctangentAdaa
+    {
+        const double scale;
+
+        explicit ArctangentAdaa(const Distortion::Controls& controls)
+        : scale(controls.drive) {}
+
+        template <typename T>
+        T f(T u) const
+        {
+            return T(2. / PI) * vatanDouble(u);
+        }
+
+        template <typename T>
+        T F1(T u) const
+        {
+            return T(2. / PI) * (u * vatanDouble(u) - T(0.5) * vlogDouble(T(1.) + u * u));
+        }
+
+        template <typename T>
+        T F2(T u) const
+        {
+            return T(2. / PI) * (T(0.5) * (u * u - T(1.)) * vatanDouble(u) + T(0.5) * u
+                                 - T(0.5) * u * vlogDouble(T(1.) + u * u));
+        }
+    };
+
+    // Hard clipping at |u| = 1
+    struct HardClipAdaa
+    {
+        const double scale;
+
+        explicit HardClipAdaa(const Distortion::Controls& controls)
+        : scale(controls.drive) {}
+
+        template <typename T>
+        T f(T u) const
+        {
+            return vmin(vmax(u, T(-1.)), T(1.));
+        }
+
+        template <typename T>
+        T F1(T u) const
+        {
+            const T a = vabs(u);
+            return vselect(a > T(1.), a - T(0.5), u * u / T(2.));
+        }
+
+        template <typename T>
+        T F2(T u) const
+        {
+            const T a = vabs(u);
+            const T outside = u * u / T(2.) - a / T(2.) + T(1. / 6.);
+            return vselect(a > T(1.), vselect(u < T(0.), -outside, outside), u * u * u / T(6.));
+        }
+    };
+
+    // x + alpha * x^2, the drive is the coefficient rather than a gain
+    struct SquareLawAdaa
+    {
+        const double scale = 1.;
+        const double alpha;
+
+        explicit SquareLawAdaa(const Distortion::Controls& controls)
+        : alpha(controls.drive) {}
+
+        template <typename T>
+        T f(T u) const
+        {
+            return u + T(alpha) * u * u;
+        }
+
+        template <typename T>
+        T F1(T u) const
+        {
+            return u * u / T(2.) + T(alpha) * u * u * u / T(3.);
+        }
+
+        template <typename T>
+        T F2(T u) const
+        {
+            return u * u * u / T(6.) + T(alpha) * u * u * u * u / T(12.);
+        }
+    };
+
+    struct CubicWaveShaperAdaa
+    {
+        const double scale;
+
+        explicit CubicWaveShaperAdaa(const Distortion::Controls& controls)
+        : scale(controls.drive) {}
+
+        template <typename T>
+        T f(T u) const
+        {
+            return T(1.5) * u - T(0.5) * u * u * u;
+        }
+
+        template <typename T>
+        T F1(T u) const
+        {
+            return T(0.75) * u * u - T(0.125) * u * u * u * u;
+        }
+
+        template <typename T>
+        T F2(T u) const
+        {
+            return T(0.25) * u * u * u - T(0.025) * u * u * u * u * u;
+        }
+    };
+
+    struct GloubiApproxAdaa
+    {
+        const double scale;
+
+        explicit GloubiApproxAdaa(const Distortion::Controls& controls)
+        : scale(controls.drive) {}
+
+        template <typename T>
+        T f(T u) const
+        {
+            return u - T(0.15) * u * u - T(0.15) * u * u * u;
+        }
+
+        template <typename T>
+        T F1(T u) const
+        {
+            return u * u / T(2.) - T(0.05) * u * u * u - T(0.0375) * u * u * u * u;
+        }
+
+        template <typename T>
+        T F2(T u) const
+        {
+            return u * u * u / T(6.) - T(0.0125) * u * u * u * u - T(0.0075) * u * u * u * u * u;
+        }
+    };
+
+    // Below these differences of u the quotients fall back to the midpoint.
+    // The second order quotient divides twice, so it needs a wider margin.
+    const double firstOrderTolerance = 1e-5;
+    const double secondOrderTolerance = 1e-4;
+
+    // The samples of a chunk, over all lanes
+    const int antialiasingChunkSize = 256;
+
+    // The history rows in front of a chunk, the last two frames of each lane
+    const int antialiasingHistorySize = 2 * Distortion::maxLanes;
+
+    /// Loads and stores double vectors and plain doubles alike
+    template <typename V>
+    struct DoubleLanes
+    {
+        static const int size = V::size;
+        static V load(const double* p)          { return V::load(p); }
+        static void store(V v, double* p)       { v.store(p); }
+    };
+
+    template <>
+    struct DoubleLanes<double>
+    {
+        static const int size = 1;
+        static double load(const double* p)     { return *p; }
+        static void store(double v, double* p)  { *p = v; }
+    };
+
+    /// Runs step.run<T>(i) over [0, numSamples), a vector V at a time and the
+    /// rest a double at a time
+    template <typename V, typename Step>
+    void runLanes(const Step& step, int numSamples)
+    {
+        int i = 0;
+        for (; i <= numSamples - DoubleLanes<V>::size; i += DoubleLanes<V>::size) {
+            step.template run<V>(i);
+        }
+        for (; i < numSamples; ++i) {
+            step.template run<double>(i);
+        }
+    }
+
+    /// Evaluates the first antiderivative, F[i] = F1(u[i])
+    template <typename Curve>
+    struct FirstAntiderivativeStep
+    {
+        const Curve& curve;
+        const double* u;
+        double* F;
+
+        template <typename T>
+        void run(int i) const
+        {
+            DoubleLanes<T>::store(curve.F1(DoubleLanes<T>::load(u + i)), F + i);
+        }
+    };
+
+    /// Evaluates the second antiderivative, F[i] = F2(u[i])
+    template <typename Curve>
+    struct SecondAntiderivativeStep
+    {
+        const Curve& curve;
+        const double* u;
+        double* F;
+
+        template <typename T>
+        void run(int i) const
+        {
+            DoubleLanes<T>::store(curve.F2(DoubleLanes<T>::load(u + i)), F + i);
+        }
+    };
+
+    /// The first order output of sample i, from the inputs and F1 of it and
+    /// of the lane's previous one, numLanes samples before
+    template <typename Curve>
+    struct FirstOrderStep
+    {
+        const Curve& curve;
+        const double* x;
+        const double* u;
+        const double* F;
+        double* y;
+        int numLanes;
+        double wet;
+
+        template <typename T>
+        void run(int i) const
+        {
+            typedef DoubleLanes<T> L;
+            const T u0 = L::load(u + i);
+            const T u1 = L::load(u + i - numLanes);
+            const T delta = u0 - u1;
+            const auto illConditioned = vabs(delta) <= T(firstOrderTolerance);
+            T wetOutput = (L::load(F + i) - L::load(F + i - numLanes)) / delta;
+            if (vany(illConditioned)) {
+                wetOutput = vselect(illConditioned, curve.f(T(0.5) * (u0 + u1)), wetOutput);
+            }
+
+            const T dryOutput = T(0.5) * (L::load(x + i) + L::load(x + i - numLanes));
+            L::store(vmuladd(T(wet), wetOutput - dryOutput, dryOutput), y + i);
+        }
+    };
+
+    /// The mean of F1 between sample i and the lane's previous one, from F2
+    template <typename Curve>
+    struct FirstDifferenceStep
+    {
+        const Curve& curve;
+        const double* u;
+        const double* F;
+        double* difference;
+        int numLanes;
+
+        template <typename T>
+        void run(int i) const
+        {
+            typedef DoubleLanes<T> L;
+            const T u0 = L::load(u + i);
+            const T u1 = L::load(u + i - numLanes);
+            const T delta = u0 - u1;
+            const auto illConditioned = vabs(delta) <= T(secondOrderTolerance);
+            T quotient = (L::load(F + i) - L::load(F + i - numLanes)) / delta;
+            if (vany(illConditioned)) {
+                quotient = vselect(illConditioned, curve.F1(T(0.5) * (u0 + u1)), quotient);
+            }
+            L::store(quotient, difference + i);
+        }
+    };
+
+    /// The second order output of sample i, from the first differences of it
+    /// and of the lane's previous one
+    template <typename Curve>
+    struct SecondOrderStep
+    {
+        const Curve& curve;
+        const double* x;
+        const double* u;
+        const double* F;
+        const double* difference;
+        double* y;
+        int numLanes;
+        double wet;
+
+        template <typename T>
+        void run(int i) const
+        {
+            typedef DoubleLanes<T> L;
+            const T u0 = L::load(u + i);
+            const T u1 = L::load(u + i - numLanes);
+            const T u2 = L::load(u + i - 2 * numLanes);
+            const T tolerance(secondOrderTolerance);
+
+            const T delta = u0 - u2;
+            const auto illConditioned = vabs(delta) <= tolerance;
+            T wetOutput = T(2.) * (L::load(difference + i) - L::load(difference + i - numLanes)) / delta;
+
+            if (vany(illConditioned)) {
+                // u0 and u2 are about the same, expand around their mean
+                const T mean = T(0.5) * (u0 + u2);
+                const T meanDelta = mean - u1;
+                const T expansion = T(2.) / meanDelta
+                                    * (curve.F1(mean) + (L::load(F + i - numLanes) - curve.F2(mean)) / meanDelta);
+                wetOutput = vselect(illConditioned,
+                                    vselect(vabs(meanDelta) > tolerance, expansion,
+                                            curve.f(T(0.5) * (mean + u1))),
+                                    wetOutput);
+            }
+
+            const T dryOutput = L::load(x + i - numLanes);
+            L::store(vmuladd(T(wet), wetOutput - dryOutput, dryOutput), y + i);
+        }
+    };
+
+    /** First order ADAA, the dry signal is delayed by half a sample
+
+        Each chunk is laid out behind a history row holding the last frame of
+        every lane, its input, u and F1, so no sample needs a special case.
+     */
+    template <typename V, typename Curve>
+    void processFirstOrder(const Distortion::Controls& controls,
+                           const float* in, float* out, int numFrames, int numLanes,
+                           float* previous, float* secondPrevious)
+    {
+        const Curve curve(controls);
+        const int chunkFrames = antialiasingChunkSize / numLanes;
+
+        double x[antialiasingHistorySize + antialiasingChunkSize];
+        double u[antialiasingHistorySize + antialiasingChunkSize];
+        double F[antialiasingHistorySize + antialiasingChunkSize];
+        double y[antialiasingChunkSize];
+
+        for (int lane = 0; lane < numLanes; ++lane) {
+            x[lane] = previous[lane];
+            u[lane] = curve.scale * x[lane];
+        }
+        runLanes<V>(FirstAntiderivativeStep<Curve> { curve, u, F }, numLanes);
+
+        for (int start = 0; start < numFrames; start += chunkFrames) {
+            const int chunkSize = std::min(chunkFrames, numFrames - start);
+            const int numSamples = chunkSize * numLanes;
+            const float* const chunkIn = in + start * numLanes;
+
+            for (int i = 0; i < numSamples; ++i) {
+                x[numLanes + i] = chunkIn[i];
+                u[numLanes + i] = curve.scale * x[numLanes + i];
+            }
+
+            runLanes<V>(FirstAntiderivativeStep<Curve> { curve, u + numLanes, F + numLanes }, numSamples);
+            runLanes<V>(FirstOrderStep<Curve> { curve, x + numLanes, u + numLanes, F + numLanes, y,
+                                                numLanes, controls.mix }, numSamples);
+
+            float* const chunkOut = out + start * numLanes;
+            for (int i = 0; i < numSamples; ++i) {
+                chunkOut[i] = static_cast<float>(y[i]);
+            }
+
+            for (int lane = 0; lane < numLanes; ++lane) {
+                secondPrevious[lane] = static_cast<float>(x[numSamples - numLanes + lane]);
+                previous[lane] = static_cast<float>(x[numSamples + lane]);
+            }
+
+            // The last frame is the history of the next chunk
+            std::copy(x + numSamples, x + numSamples + numLanes, x);
+            std::copy(u + numSamples, u + numSamples + numLanes, u);
+            std::copy(F + numSamples, F + numSamples + numLanes, F);
+        }
+    }
+
+    /** Second order ADAA, the dry signal is delayed by a sample
+
+        Like processFirstOrder, with the last two frames as history, and the
+        first difference of the last one.
+     */
+    template <typename V, typename Curve>
+    void processSecondOrder(const Distortion::Controls& controls,
+                            const float* in, float* out, int numFrames, int numLanes,
+                            float* previous, float* secondPrevious)
+    {
+        const Curve curve(controls);
+        const int chunkFrames = antialiasingChunkSize / numLanes;
+        const int historySize = 2 * numLanes;
+
+        double x[antialiasingHistorySize + antialiasingChunkSize];
+        double u[antialiasingHistorySize + antialiasingChunkSize];
+        double F[antialiasingHistorySize + antialiasingChunkSize];
+        double difference[antialiasingHistorySize + antialiasingChunkSize];
+        double y[antialiasingChunkSize];
+
+        for (int lane = 0; lane < numLanes; ++lane) {
+            x[lane] = secondPrevious[lane];
+            x[numLanes + lane] = previous[lane];
+        }
+        for (int i = 0; i < historySize; ++i) {
+            u[i] = curve.scale * x[i];
+        }
+        runLanes<V>(SecondAntiderivativeStep<Curve> { curve, u, F }, historySize);
+        runLanes<V>(FirstDifferenceStep<Curve> { curve, u + numLanes, F + numLanes, difference + numLanes,
+                                                 numLanes }, numLanes);
+
+        for (int start = 0; start < numFrames; start += chunkFrames) {
+            const int chunkSize = std::min(chunkFrames, numFrames - start);
+            const int numSamples = chunkSize * numLanes;
+            const float* const chunkIn = in + start * numLanes;
+
+            for (int i = 0; i < numSamples; ++i) {
+                x[historySize + i] = chunkIn[i];
+                u[historySize + i] = curve.scale * x[historySize + i];
+            }
+
+            double* const chunkU = u + historySize;
+            double* const chunkF = F + historySize;
+            double* const chunkDifference = difference + historySize;
+            runLanes<V>(SecondAntiderivativeStep<Curve> { curve, chunkU, chunkF }, numSamples);
+            runLanes<V>(FirstDifferenceStep<Curve> { curve, chunkU, chunkF, chunkDifference, numLanes },
+                        numSamples);
+            runLanes<V>(SecondOrderStep<Curve> { curve, x + historySize, chunkU, chunkF, chunkDifference, y,
+                                                 numLanes, controls.mix }, numSamples);
+
+            float* const chunkOut = out + start * numLanes;
+            for (int i = 0; i < numSamples; ++i) {
+                chunkOut[i] = static_cast<float>(y[i]);
+            }
+
+            for (int lane = 0; lane < numLanes; ++lane) {
+                secondPrevious[lane] = static_cast<float>(x[numSamples + lane]);
+                previous[lane] = static_cast<float>(x[numSamples + numLanes + lane]);
+            }
+
+            // The last two frames are the history of the next chunk
+            std::copy(x + numSamples, x + numSamples + historySize, x);
+            std::copy(u + numSamples, u + numSamples + historySize, u);
+            std::copy(F + numSamples, F + numSamples + historySize, F);
+            std::copy(difference + numSamples + numLanes, difference + numSamples + historySize,
+                      difference + numLanes);
+        }
+    }
+
+    /** The curves without a closed form antiderivative, and bypass, run on the
+        input delayed like the ADAA output: the midpoint of the last two inputs
+        for the first order, the previous input for the second.
+
+        The delayed input is put together a chunk at a time, behind the last
+        frame of the previous one, and goes through the mode's float kernel.
+     */
+    template <typename Kernel, typename Shaper, int Order>
+    void processDelayed(const Distortion::Controls& controls,
+                        const float* in, float* out, int numFrames, int numLanes,
+                        float* previous, float* secondPrevious)
+    {
+        const int chunkFrames = antialiasingChunkSize / numLanes;
+        const bool hasMix = controls.mix != 1.f;
+
+        float x[Distortion::maxLanes + antialiasingChunkSize];
+        float delayed[antialiasingChunkSize];
+        std::copy(previous, previous + numLanes, x);
+
+        for (int start = 0; start < numFrames; start += chunkFrames) {
+            const int chunkSize = std::min(chunkFrames, numFrames - start);
+            const int numSamples = chunkSize * numLanes;
+            std::copy(in + start * numLanes, in + start * numLanes + numSamples, x + numLanes);
+
+            for (int i = 0; i < numSamples; ++i) {
+                delayed[i] = Order == 1 ? 0.5f * (x[numLanes + i] + x[i]) : x[i];
+            }
+
+            float* const chunkOut = out + start * numLanes;
+            if (hasMix) {
+                Kernel::template process<Shaper, true>(controls, delayed, chunkOut, numSamples);
+            }
+            else {
+                Kernel::template process<Shaper, false>(controls, delayed, chunkOut, numSamples);
+            }
+
+            std::copy(x + numSamples - numLanes, x + numSamples, secondPrevious);
+            std::copy(x + numSamples, x + numSamples + numLanes, previous);
+            std::copy(x + numSamples, x + numSamples + numLanes, x);
+        }
+    }
+}
+}
+
+#endif  // ANTIALIASEDKERNELS_H_INCLUDED
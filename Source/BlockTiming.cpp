@@ -0,0 +1,171 @@
+#include "BlockTiming.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    // How long collect() waits after construction before it measures the
+    // counter rate and takes the first blocks
+    const double minimumReferenceTime = 0.02;
+
+    // Returns the value below which a fraction of the sorted values fall
+    double getPercentile(const std::vector<double>& sorted, double fraction)
+    {
+        const size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+}
+
+BlockTiming::BlockTiming()
+: dropped(0),
+  sampleRate(44100.),
+  history(historySize),
+  historyStart(0),
+  numRecords(0),
+  totalBlocks(0),
+  deadlineMisses(0),
+  worstLoad(0.),
+  droppedBeforeReset(0),
+  referenceTicks(readTicks()),
+  referenceSeconds(getSeconds()),
+  ticksPerSecond(0.)
+{
+    sortedLoads.reserve(historySize);
+}
+
+void BlockTiming::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+}
+
+void BlockTiming::addBlock(Ticks start, Ticks end, int numSamples)
+{
+    const Record record = { start, end - start, numSamples, numSamples / sampleRate };
+    if (!queue.push(record)) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+double BlockTiming::getSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Measures the counter rate over the whole time since construction, so it
+/// gets more precise with every call
+void BlockTiming::updateTicksPerSecond()
+{
+    const Ticks ticks = readTicks();
+    const double seconds = getSeconds();
+    if (seconds - referenceSeconds >= minimumReferenceTime) {
+        ticksPerSecond = static_cast<double>(ticks - referenceTicks) / (seconds - referenceSeconds);
+    }
+}
+
+double BlockTiming::getLoad(const Record& record) const
+{
+    if (record.budget <= 0.) {
+        return 0.;
+    }
+    return static_cast<double>(record.duration) / ticksPerSecond / record.budget;
+}
+
+void BlockTiming::collect()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    updateTicksPerSecond();
+    if (ticksPerSecond <= 0.) {
+        // Too early to tell the durations, the queue holds the blocks
+        return;
+    }
+
+    Record record;
+    while (queue.pop(record)) {
+        const double load = getLoad(record);
+        ++totalBlocks;
+        if (load > 1.) {
+            ++deadlineMisses;
+        }
+        worstLoad = std::max(worstLoad, load);
+
+        if (numRecords < historySize) {
+            history[numRecords++] = record;
+        }
+        else {
+            history[historyStart] = record;
+            historyStart = (historyStart + 1) % historySize;
+        }
+    }
+}
+
+BlockTiming::Statistics BlockTiming::getStatistics()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    Statistics statistics = {};
+    statistics.numBlocks = numRecords;
+    statistics.totalBlocks = totalBlocks;
+    statistics.deadlineMisses = deadlineMisses;
+    statistics.worstLoad = worstLoad;
+    statistics.droppedBlocks = dropped.load(std::memory_order_relaxed) - droppedBeforeReset;
+
+    if (numRecords > 0) {
+        sortedLoads.clear();
+        for (int i = 0; i < numRecords; ++i) {
+            sortedLoads.push_back(getLoad(history[i]));
+        }
+        std::sort(sortedLoads.begin(), sortedLoads.end());
+
+        statistics.median = getPercentile(sortedLoads, 0.5);
+        statistics.percentile90 = getPercentile(sortedLoads, 0.9);
+        statistics.percentile99 = getPercentile(sortedLoads, 0.99);
+        statistics.percentile999 = getPercentile(sortedLoads, 0.999);
+        statistics.maximum = sortedLoads.back();
+    }
+    return statistics;
+}
+
+std::string BlockTiming::createReport()
+{
+    const Statistics statistics = getStatistics();
+    std::lock_guard<std::mutex> guard(lock);
+
+    std::string report;
+    char line[256];
+
+    std::snprintf(line, sizeof(line),
+                  "# Blocks: %lld, deadline misses: %lld, worst load: %.4f, dropped: %lld\n"
+                  "# Load of the last %d blocks, median: %.4f, 90%%: %.4f, 99%%: %.4f, 99.9%%: %.4f, max: %.4f\n"
+                  "start (s),samples,budget (us),duration (us),load\n",
+                  static_cast<long long>(statistics.totalBlocks),
+                  static_cast<long long>(statistics.deadlineMisses), statistics.worstLoad,
+                  static_cast<long long>(statistics.droppedBlocks), statistics.numBlocks,
+                  statistics.median, statistics.percentile90, statistics.percentile99,
+                  statistics.percentile999, statistics.maximum);
+    report += line;
+
+    for (int i = 0; i < numRecords; ++i) {
+        const Record& record = history[(historyStart + i) % historySize];
+        const double start = (static_cast<double>(record.start) - static_cast<double>(referenceTicks)) / ticksPerSecond;
+        std::snprintf(line, sizeof(line), "%.6f,%d,%.1f,%.1f,%.4f\n",
+                      start, record.numSamples, record.budget * 1e6,
+                      static_cast<double>(record.duration) / ticksPerSecond * 1e6, getLoad(record));
+        report += line;
+    }
+    return report;
+}
+
+void BlockTiming::reset()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    historyStart = 0;
+    numRecords = 0;
+    totalBlocks = 0;
+    deadlineMisses = 0;
+    worstLoad = 0.;
+    droppedBeforeReset = dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,171 @@
+#ifndef BLOCKTIMING_H_INCLUDED
+#define BLOCKTIMING_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SpscQueue.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+ #define DISTORTION_TIMING_TSC 1
+#else
+ #include <chrono>
+ #define DISTORTION_TIMING_TSC 0
+#endif
+
+/**
+    Measures how long each processed block takes against its real-time
+    budget, the time the host has to deliver it, numSamples / sampleRate.
+
+    The audio thread reads a cycle counter around each block and pushes a
+    record into a lock-free queue, see ScopedBlock. That's all it does, no
+    locks and no allocation. A reader thread drains the queue with collect()
+    into a history of the latest blocks, from which it works out the load
+    percentiles, the worst load and the deadline misses, the blocks that took
+    longer than their budget. A load of 1 is the whole budget.
+
+    The counter is the time stamp counter on x86, which ticks at a constant
+    rate on current CPUs. Its rate is measured against the system clock
+    while collecting, so the first loads are only known once collect() has
+    run a few tens of milliseconds after construction. Elsewhere it's the
+    system's steady clock.
+
+    Every reader method can be called from any thread but the audio thread,
+    they share a lock.
+ */
+class BlockTiming
+{
+public:
+    typedef uint64_t Ticks;
+
+    BlockTiming();
+
+    /// Sets the sample rate of the blocks to come, before they're processed
+    void prepare(double sampleRate);
+
+    /// Reads the cycle counter
+    static Ticks readTicks()
+    {
+       #if DISTORTION_TIMING_TSC
+        return __rdtsc();
+       #else
+        return static_cast<Ticks>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+       #endif
+    }
+
+    /// Times a block of numSamples from construction to destruction, on the
+    /// audio thread
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock(BlockTiming& newTiming, int newNumSamples)
+        : timing(newTiming), numSamples(newNumSamples), start(readTicks())
+        {
+        }
+
+        ~ScopedBlock()
+        {
+            timing.addBlock(start, readTicks(), numSamples);
+        }
+
+        ScopedBlock(const ScopedBlock&) = delete;
+        ScopedBlock& operator=(const ScopedBlock&) = delete;
+
+    private:
+        BlockTiming& timing;
+        const int numSamples;
+        const Ticks start;
+    };
+
+    /// Records a block that took from start to end, on the audio thread
+    void addBlock(Ticks start, Ticks end, int numSamples);
+
+    /// Moves the queued blocks into the history, call it regularly
+    void collect();
+
+    struct Statistics
+    {
+        // The blocks in the history
+        int numBlocks;
+        // Load percentiles over the history
+        double median;
+        double percentile90;
+        double percentile99;
+        double percentile999;
+        double maximum;
+        // Since construction or reset()
+        int64_t totalBlocks;
+        int64_t deadlineMisses;
+        double worstLoad;
+        // Blocks lost because the queue was full
+        int64_t droppedBlocks;
+    };
+
+    /// Returns the statistics of the blocks collected so far
+    Statistics getStatistics();
+
+    /** Returns the statistics and the history as text
+
+        A few comment lines of statistics, then a CSV line per block: its
+        start in seconds since construction, its number of samples, its
+        budget and duration in microseconds and its load.
+     */
+    std::string createReport();
+
+    /// Forgets the collected blocks
+    void reset();
+
+    /// The number of blocks kept in the history
+    static const int historySize = 8192;
+
+private:
+    struct Record
+    {
+        Ticks start;
+        Ticks duration;
+        int numSamples;
+        // The budget in seconds
+        double budget;
+    };
+
+    static const int queueSize = 4096;
+    SpscQueue<Record, queueSize> queue;
+    // Records that didn't fit the queue, only the audio thread writes it
+    std::atomic<int64_t> dropped;
+    // Set in prepare(), before the audio thread reads it
+    double sampleRate;
+
+    std::mutex lock;
+
+    // The latest blocks, a ring starting at historyStart once full
+    std::vector<Record> history;
+    int historyStart;
+    int numRecords;
+    std::vector<double> sortedLoads;
+
+    // Since construction or reset()
+    int64_t totalBlocks;
+    int64_t deadlineMisses;
+    double worstLoad;
+    int64_t droppedBeforeReset;
+
+    // The counter rate, measured between construction and collect()
+    Ticks referenceTicks;
+    double referenceSeconds;
+    double ticksPerSecond;
+
+    static double getSeconds();
+    double getLoad(const Record& record) const;
+    void updateTicksPerSecond();
+};
+
+#endif  // BLOCKTIMING_H_INCLUDED
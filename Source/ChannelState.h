@@ -0,0 +1,60 @@
+#ifndef CHANNELSTATE_H_INCLUDED
+#define CHANNELSTATE_H_INCLUDED
+
+#include <algorithm>
+#include <vector>
+
+/**
+    Per-channel processing state, stored structure-of-arrays.
+
+    Every state variable is an array holding one T per channel, so the
+    values of neighbouring channels are contiguous. A SIMD path that processes
+    channels as vector lanes can then load a variable for all of its channels
+    at once. Filter histories and ramps are floats, counters and modes are
+    kept apart as integers.
+
+    Memory is only allocated by setSize(), call it before playback.
+ */
+template <typename T>
+class ChannelState
+{
+public:
+    ChannelState() {}
+
+    /// Allocates numVariables arrays of numChannels values, all cleared
+    void setSize(int numVariables, int newNumChannels)
+    {
+        numChannels = newNumChannels;
+        data.assign(static_cast<size_t>(numVariables * numChannels), T());
+    }
+
+    /// Clears every variable of every channel
+    void reset()
+    {
+        std::fill(data.begin(), data.end(), T());
+    }
+
+    /// Returns the number of channels
+    int getNumChannels() const
+    {
+        return numChannels;
+    }
+
+    /// Returns the values of a variable, indexed by channel
+    T* getVariable(int variable)
+    {
+        return data.data() + variable * numChannels;
+    }
+
+    /// Returns the values of a variable, indexed by channel
+    const T* getVariable(int variable) const
+    {
+        return data.data() + variable * numChannels;
+    }
+
+private:
+    std::vector<T> data;
+    int numChannels = 0;
+};
+
+#endif  // CHANNELSTATE_H_INCLUDED
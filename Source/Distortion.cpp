@@ -1,180 +1,596 @@
 #include "Distortion.h"
+#include "DistortionDispatch.h"
+#include "DistortionKernels.h"
+#include "ScopedFlushDenormals.h"
+#include "TransferTableCache.h"
 
-Distortion::Distortion() {
+#include <algorithm>
+
+namespace
+{
+    /// The curves worth tabulating, as functions of drive * input, or nullptr
+    TransferTableCache::Curve getTabulatedCurve(int mode)
+    {
+        switch (mode) {
+            case 8:  return DistortionKernels::GloubiBoulga::curve;
+            default: return nullptr;
+        }
+    }
+    
+    // Gloubi-Boulga only settles far beyond full scale, the tables cover five
+    // times full scale at the highest drive and clamp beyond
+    const float tableDomain = 128.f;
+    
+    // The length of the crossfade between two modes
+    const double crossfadeTime = 0.01;
+    
+    // Caps the count of silent frames, far from overflowing
+    const int maximumSilentFrames = 1 << 30;
+    
+    /// Returns true if every sample is zero
+    template <typename Sample>
+    bool isSilent(const Sample* samples, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            if (samples[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+const double Distortion::defaultSmoothingTime = 0.02;
+
+Distortion::Distortion()
+: kernelSet(&DistortionKernels::selectKernelSet()),
+  antialiasing(noAntialiasing),
+  curveTables(noCurveTables),
+  accuracy(referenceAccuracy),
+  smoothingShape(ParameterSmoother::linear),
+  smoothingTime(defaultSmoothingTime),
+  sampleRate(44100.)
+{
     controls.mode = 0;
     controls.drive = 1.f;
+    controls.threshold = 1.f;
     controls.mix = 0.f;
+    controls.shape = 0.5f;
+    
+    // Usable before the host prepares playback
+    prepare(44100., 512, 1);
 }
 
 Distortion::~Distortion() {}
 
+void Distortion::prepare(double newSampleRate, int newMaximumBlockSize, int numChannels)
+{
+    setKernelSet(DistortionKernels::selectKernelSet());
+    
+    numChannels = std::max(numChannels, 1);
+    maximumBlockSize = std::max(newMaximumBlockSize, 1);
+    state.setSize(numStateVariables, numChannels);
+    integerState.setSize(numIntegerStateVariables, numChannels);
+    oversampler.prepare(maximumBlockSize, std::min(numChannels, static_cast<int>(maxLanes)), numChannels);
+    
+    sampleRate = newSampleRate;
+    driveSmoother.prepare(numChannels);
+    mixSmoother.prepare(numChannels);
+    updateSmoothing();
+    resetCrossfade();
+    
+    // The curves don't depend on the controls, so each is only sampled once
+    // per process
+    for (int mode = 0; mode < numModes; ++mode) {
+        const TransferTableCache::Curve curve = getTabulatedCurve(mode);
+        if (curve != nullptr && tables[mode] == nullptr) {
+            const TransferTableCache::Key key = { mode, 0.f, TransferTable::defaultNumPoints };
+            tables[mode] = TransferTableCache::getInstance().getTable(key, curve, -tableDomain, tableDomain);
+        }
+    }
+}
+
+void Distortion::reset()
+{
+    state.reset();
+    integerState.reset();
+    oversampler.reset();
+    updateSmoothing();
+    resetCrossfade();
+}
+
+/// Settles every channel on the current mode, without a crossfade
+void Distortion::resetCrossfade()
+{
+    const int mode = (controls.mode >= 0 && controls.mode < numModes) ? controls.mode : 0;
+    int* const modes = integerState.getVariable(crossfadeMode);
+    int* const remaining = integerState.getVariable(crossfadeRemaining);
+    
+    for (int channel = 0; channel < integerState.getNumChannels(); ++channel) {
+        modes[channel] = mode;
+        remaining[channel] = 0;
+    }
+}
+
+void Distortion::setKernelSet(const DistortionKernels::KernelSet& newKernelSet)
+{
+    kernelSet = &newKernelSet;
+    oversampler.setConvolution(kernelSet->convolution);
+}
+
+const char* Distortion::getKernelSetName() const
+{
+    return kernelSet->name;
+}
+
 float Distortion::processSample(float sample)
 {
-    input = sample;
-    output = input * controls.drive;
-    
-    switch (controls.mode) {
-        case 1:
-            output = softClip(output);
-            break;
-        case 2:
-            output = arctangent(input, controls.drive);
-            break;
-        case 3:
-            output = hardClip(output);
-            break;
-        case 4:
-            output = squareLaw(input, controls.drive);
-            break;
-        case 5:
-            output = cubicWaveShaper(output);
-            break;
-        case 6:
-            output = foldback(output);
-            break;
-        case 7:
-            output = gloubiApprox(output);
-            break;
-        case 8:
-            output = gloubiBoulga(output);
-            break;
-        default:
-            output = input;
-            break;
-    }
-    
-    return (1.f - controls.mix) * input + controls.mix * output;
-}
-
-/** Cubic soft-clipping nonlinearity
- 
-    Use 3x oversampling to eliminate aliasing
+    float output;
+    processBlock(0, &sample, &output, 1);
+    return output;
+}
+
+void Distortion::processBlock(int channel, const float* in, float* out, int numSamples)
+{
+    processFrames(channel, 1, in, out, numSamples);
+}
+
+void Distortion::processBlock(int channel, float* samples, int numSamples)
+{
+    processFrames(channel, 1, samples, samples, numSamples);
+}
+
+void Distortion::processBlock(int channel, const double* in, double* out, int numSamples)
+{
+    processFrames(channel, 1, in, out, numSamples);
+}
+
+void Distortion::processBlock(int channel, double* samples, int numSamples)
+{
+    processFrames(channel, 1, samples, samples, numSamples);
+}
+
+void Distortion::processInterleaved(int firstChannel, int numLanes, float* frames, int numFrames)
+{
+    processFrames(firstChannel, numLanes, frames, frames, numFrames);
+}
+
+/**
+    Processes frames of numLanes interleaved channels.
+
+    Without oversampling the nonlinearity runs straight from in to out.
+    Otherwise it runs on the upsampled frames, dry/wet mix included, so the dry
+    signal goes through the same filters and stays aligned with the wet one.
+
+    Nothing runs when the output is the input, see isTransparent(), or once
+    the input has been silent for longer than the tail, as every mode maps
+    silence to silence.
+
+    Every stateful stage runs from here, with denormals flushed to zero, so
+    decaying tails can't slow the filters, ramps or ADAA down. Under
+    denormals-are-zero a denormal tail also counts as silence.
  */
-float Distortion::softClip(float sample)
+template <typename Sample>
+void Distortion::processFrames(int firstChannel, int numLanes, const Sample* in, Sample* out, int numFrames)
 {
-    if (sample < -1.f) {
-        return -softClipThreshold;
+    if (numFrames <= 0) {
+        return;
+    }
+    
+    const ScopedFlushDenormals flushDenormals;
+    
+    const int mode = (controls.mode >= 0 && controls.mode < numModes) ? controls.mode : 0;
+    const int numSamples = numFrames * numLanes;
+    
+    int* const silentFrames = integerState.getVariable(silence) + firstChannel;
+    const bool silent = isSilent(in, numSamples);
+    for (int lane = 0; lane < numLanes; ++lane) {
+        silentFrames[lane] = silent ? std::min(silentFrames[lane] + numFrames, maximumSilentFrames) : 0;
     }
-    else if (sample > 1.f) {
-        return softClipThreshold;
+    
+    if (isTransparent(firstChannel, numLanes)) {
+        if (in != out) {
+            std::copy(in, in + numSamples, out);
+        }
+        return;
     }
-    else {
-        return sample - ((sample * sample * sample) / 3.f);
+    
+    // The stateful stages only hold silence once the tail has passed. The
+    // ramps and crossfades have to finish first, they would stall otherwise.
+    if (silent && silentFrames[0] > numFrames + getTailLengthInSamples() && isSteady(firstChannel, numLanes)) {
+        if (in != out) {
+            std::fill(out, out + numSamples, Sample(0));
+        }
+        return;
+    }
+    
+    processStages(mode, firstChannel, numLanes, in, out, numFrames);
+}
+
+/// Runs the oversampling and the nonlinearity
+void Distortion::processStages(int mode, int firstChannel, int numLanes,
+                               const float* in, float* out, int numFrames)
+{
+    if (oversampler.getNumStages() == 0) {
+        processNonlinearity(mode, firstChannel, numLanes, in, out, numFrames);
+        return;
+    }
+    
+    // The oversampling buffers hold at most maximumBlockSize frames
+    const int factor = oversampler.getFactor();
+    for (int start = 0; start < numFrames; start += maximumBlockSize) {
+        const int blockSize = std::min(maximumBlockSize, numFrames - start);
+        const int offset = start * numLanes;
+        
+        float* upsampled = oversampler.processUp(firstChannel, numLanes, in + offset, blockSize);
+        processNonlinearity(mode, firstChannel, numLanes, upsampled, upsampled, blockSize * factor);
+        oversampler.processDown(firstChannel, numLanes, out + offset, blockSize);
     }
 }
 
-// Arctangent nonlinearity
-float Distortion::arctangent(float sample, float alpha)
+/**
+    Runs the double precision kernel of a mode directly when no stage in
+    between needs floats, otherwise converts the frames to floats a chunk at a
+    time and runs the float stages.
+
+    The filters, ramps and ADAA state are floats, and the crossfade is only
+    started by the float stages.
+ */
+void Distortion::processStages(int mode, int firstChannel, int numLanes,
+                               const double* in, double* out, int numFrames)
 {
-    // f(x) = (2 / PI) * arctan(alpha * x[n]), where alpha >> 1 (drive param)
-    return (2.f / PI)* atan(alpha * sample);
+    const int runningMode = integerState.getVariable(crossfadeMode)[firstChannel];
+    if (oversampler.getNumStages() == 0 && antialiasing == noAntialiasing
+        && runningMode == mode && isSteady(firstChannel, numLanes)) {
+        const int numSamples = numFrames * numLanes;
+        const bool hasMix = controls.mix != 1.f;
+        if (curveTables != noCurveTables && tables[mode] != nullptr) {
+            const int interpolation = curveTables == linearCurveTables ? 0 : 1;
+            kernelSet->doubleTableKernels[interpolation][hasMix](controls, *tables[mode], in, out, numSamples);
+        }
+        else {
+            kernelSet->doubleKernels[getKernel(mode)][hasMix](controls, in, out, numSamples);
+        }
+        return;
+    }
+    
+    const int chunkFrames = rampSize / numLanes;
+    for (int start = 0; start < numFrames; start += chunkFrames) {
+        const int chunkSize = std::min(chunkFrames, numFrames - start);
+        const int offset = start * numLanes;
+        const int chunkSamples = chunkSize * numLanes;
+        
+        for (int i = 0; i < chunkSamples; ++i) {
+            conversionBuffer[i] = static_cast<float>(in[offset + i]);
+        }
+        processStages(mode, firstChannel, numLanes, conversionBuffer, conversionBuffer, chunkSize);
+        for (int i = 0; i < chunkSamples; ++i) {
+            out[offset + i] = conversionBuffer[i];
+        }
+    }
 }
 
-// Hard-clipping nonlinearity
-float Distortion::hardClip(float sample)
+/**
+    Returns true if the output of numLanes channels from firstChannel is their
+    input, in bypass or without a wet signal.
+
+    With oversampling or anti-aliasing on, the signal is still delayed and
+    filtered even then, and a crossfade or a mix ramp changes it.
+ */
+bool Distortion::isTransparent(int firstChannel, int numLanes)
 {
-    if (sample < -1.f) {
-        return -1.f;
+    if (oversampler.getNumStages() != 0 || antialiasing != noAntialiasing) {
+        return false;
     }
-    else if (sample > 1.f) {
-        return 1.f;
+    
+    const int mode = (controls.mode >= 0 && controls.mode < numModes) ? controls.mode : 0;
+    const bool dry = controls.mix == 0.f;
+    if (mode != 0 && ! dry) {
+        return false;
     }
-    else {
-        return sample;
+    
+    const int* const modes = integerState.getVariable(crossfadeMode) + firstChannel;
+    for (int lane = 0; lane < numLanes; ++lane) {
+        if (! dry && modes[lane] != 0) {
+            return false;
+        }
     }
+    
+    // With the mix settled, a dry mix is at 0
+    return isSteady(firstChannel, numLanes);
 }
 
-// Square law series expansion
-float Distortion::squareLaw(float sample, float alpha)
+/// Returns true if no lane is in a crossfade and the drive and mix are settled
+bool Distortion::isSteady(int firstChannel, int numLanes)
 {
-    return sample + alpha * sample * sample;
+    driveSmoother.setTarget(controls.drive);
+    mixSmoother.setTarget(controls.mix);
+    if (! driveSmoother.isSettled(firstChannel, numLanes) || ! mixSmoother.isSettled(firstChannel, numLanes)) {
+        return false;
+    }
+    
+    const int* const remaining = integerState.getVariable(crossfadeRemaining) + firstChannel;
+    for (int lane = 0; lane < numLanes; ++lane) {
+        if (remaining[lane] > 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
-/** A cubic nonlinearity, input range: [-1, 1]?
- 
-    Use 3x oversampling to eliminate aliasing
+/**
+    Runs the nonlinearity of a mode, crossfading from the previous mode when
+    it changes.
+
+    During the crossfade both modes run and their outputs are mixed with
+    gains that sum to 1, afterwards only the new one runs. The curves all
+    follow the input, so their outputs are correlated and equal-power gains
+    would swell by up to 3 dB mid-fade. A mode change during a crossfade
+    starts a new one from the mode that was fading in.
  */
-float Distortion::cubicWaveShaper(float sample)
+void Distortion::processNonlinearity(int mode, int firstChannel, int numLanes,
+                                     const float* in, float* out, int numFrames)
 {
-    return 1.5f * sample - 0.5f * sample * sample * sample;
+    // The lanes see the same controls, so they're always in the same crossfade
+    int* const modes = integerState.getVariable(crossfadeMode) + firstChannel;
+    int* const previousModes = integerState.getVariable(crossfadePreviousMode) + firstChannel;
+    int* const remaining = integerState.getVariable(crossfadeRemaining) + firstChannel;
+    
+    const int length = std::max(static_cast<int>(crossfadeTime * sampleRate * oversampler.getFactor() + 0.5), 1);
+    
+    if (modes[0] != mode) {
+        for (int lane = 0; lane < numLanes; ++lane) {
+            previousModes[lane] = modes[lane];
+            modes[lane] = mode;
+            remaining[lane] = length;
+        }
+    }
+    
+    const int crossfadeFrames = std::min(remaining[0], numFrames);
+    if (crossfadeFrames > 0) {
+        processCrossfade(previousModes[0], mode, length - remaining[0], length,
+                         firstChannel, numLanes, in, out, crossfadeFrames);
+        
+        for (int lane = 0; lane < numLanes; ++lane) {
+            remaining[lane] -= crossfadeFrames;
+        }
+        in += crossfadeFrames * numLanes;
+        out += crossfadeFrames * numLanes;
+        numFrames -= crossfadeFrames;
+    }
+    
+    if (numFrames > 0) {
+        processMode(mode, firstChannel, numLanes, in, out, numFrames);
+    }
 }
 
-// Foldback nonlinearity, input range: (-inf, inf)
-float Distortion::foldback(float sample)
+/**
+    Runs position to position + numFrames of a crossfade of length frames
+    between two modes, a chunk at a time.
+
+    The new mode runs as usual. The old mode runs on the same input with the
+    controls held over each chunk, and its ADAA state is put back afterwards
+    so the new mode carries on from it.
+ */
+void Distortion::processCrossfade(int previousMode, int mode, int position, int length,
+                                  int firstChannel, int numLanes,
+                                  const float* in, float* out, int numFrames)
 {
-    // Threshold should be > 0.f
-    if (sample > controls.threshold || sample < -controls.threshold) {
-        sample = fabs(fabs(fmod(sample - controls.threshold,
-                                controls.threshold * 4))
-                      - controls.threshold * 2) - controls.threshold;
+    const int chunkFrames = rampSize / numLanes;
+    float* const previous = state.getVariable(antialiasingInput1) + firstChannel;
+    float* const secondPrevious = state.getVariable(antialiasingInput2) + firstChannel;
+    
+    // The gain of the new mode rises linearly over the crossfade, the old
+    // one's falls as much
+    const double step = 1. / length;
+    
+    for (int start = 0; start < numFrames; start += chunkFrames) {
+        const int chunkSize = std::min(chunkFrames, numFrames - start);
+        const int offset = start * numLanes;
+        
+        Controls heldControls = controls;
+        heldControls.mode = previousMode;
+        heldControls.drive = driveSmoother.getCurrentValue(firstChannel);
+        heldControls.mix = mixSmoother.getCurrentValue(firstChannel);
+        
+        float savedPrevious[maxLanes];
+        float savedSecondPrevious[maxLanes];
+        std::copy(previous, previous + numLanes, savedPrevious);
+        std::copy(secondPrevious, secondPrevious + numLanes, savedSecondPrevious);
+        
+        processConstant(previousMode, heldControls, firstChannel, numLanes,
+                        in + offset, crossfadeBuffer, chunkSize);
+        
+        std::copy(savedPrevious, savedPrevious + numLanes, previous);
+        std::copy(savedSecondPrevious, savedSecondPrevious + numLanes, secondPrevious);
+        
+        processMode(mode, firstChannel, numLanes, in + offset, out + offset, chunkSize);
+        
+        double fadeIn = step * (position + start + 1);
+        float* const chunk = out + offset;
+        
+        for (int frame = 0; frame < chunkSize; ++frame) {
+            for (int lane = 0; lane < numLanes; ++lane) {
+                const int i = frame * numLanes + lane;
+                chunk[i] = static_cast<float>(crossfadeBuffer[i] + fadeIn * (chunk[i] - crossfadeBuffer[i]));
+            }
+            fadeIn += step;
+        }
     }
-    return sample;
 }
 
-// A nonlinearity by Partice Tarrabia and Bram de Jong
-float Distortion::waveShaper1(float sample, float alpha)
+/// Runs the kernel of a mode, through ADAA or the curve's table if they're on
+void Distortion::processMode(int mode, int firstChannel, int numLanes,
+                             const float* in, float* out, int numFrames)
 {
-    const float k = 2.f * alpha / (1.f - alpha);
-    return (1.f + k) * sample / (1.f + k * fabs(sample));
+    driveSmoother.setTarget(controls.drive);
+    mixSmoother.setTarget(controls.mix);
+    const bool settled = driveSmoother.isSettled(firstChannel, numLanes)
+                         && mixSmoother.isSettled(firstChannel, numLanes);
+    
+    if (antialiasing != noAntialiasing) {
+        // The ADAA kernels take constant controls, the ramps move a block at a time
+        Controls blockControls = controls;
+        if (! settled) {
+            driveSmoother.process(firstChannel, numLanes, nullptr, numFrames);
+            mixSmoother.process(firstChannel, numLanes, nullptr, numFrames);
+            blockControls.drive = driveSmoother.getCurrentValue(firstChannel);
+            blockControls.mix = mixSmoother.getCurrentValue(firstChannel);
+        }
+        
+        processConstant(mode, blockControls, firstChannel, numLanes, in, out, numFrames);
+        return;
+    }
+    
+    if (! settled) {
+        processModulated(mode, firstChannel, numLanes, in, out, numFrames);
+        return;
+    }
+    
+    processConstant(mode, controls, firstChannel, numLanes, in, out, numFrames);
 }
 
-// A nonlinearity by Jon Watte
-float Distortion::waveShaper2(float sample, float alpha)
+/// Runs the kernel of a mode with constant controls, through ADAA or the
+/// curve's table if they're on
+void Distortion::processConstant(int mode, const Controls& constantControls, int firstChannel, int numLanes,
+                                 const float* in, float* out, int numFrames)
 {
-    const float z = PI * alpha;
-    const float s = 1.f / sin(z);
-    const float b = 1.f / alpha;
+    if (antialiasing != noAntialiasing) {
+        const int order = antialiasing == firstOrderAntialiasing ? 1 : 2;
+        kernelSet->antialiasedKernels[mode][order - 1](
+            constantControls, in, out, numFrames, numLanes,
+            state.getVariable(antialiasingInput1) + firstChannel,
+            state.getVariable(antialiasingInput2) + firstChannel);
+        return;
+    }
     
-    if (sample > b) {
-        return 1.f;
+    const bool hasMix = constantControls.mix != 1.f;
+    if (curveTables != noCurveTables && tables[mode] != nullptr) {
+        const int interpolation = curveTables == linearCurveTables ? 0 : 1;
+        kernelSet->tableKernels[interpolation][hasMix](constantControls, *tables[mode], in, out, numFrames * numLanes);
     }
     else {
-        return sin(z * sample) * s;
+        kernelSet->kernels[getKernel(mode)][hasMix](constantControls, in, out, numFrames * numLanes);
     }
 }
 
-// A nonlinearity by Bram de Jong, input range: [-1, 1]
-float Distortion::waveShaper3(float sample, float alpha)
+/// Runs the modulated kernel of a mode, a chunk of ramps at a time
+void Distortion::processModulated(int mode, int firstChannel, int numLanes,
+                                  const float* in, float* out, int numFrames)
 {
-    // original design requires sample be positive
-    // alpha: [0, 1]
-    bool isNegative = false;
-    float output = sample;
-    if (sample < 0.f) {
-        isNegative = true;
-        output = -output;
-    }
+    const int chunkFrames = rampSize / numLanes;
+    const bool useTable = curveTables != noCurveTables && tables[mode] != nullptr;
+    const int interpolation = curveTables == linearCurveTables ? 0 : 1;
     
-    if (output > alpha) {
-        output = alpha + (output - alpha)
-            / (1.f + powf(((output - alpha) / (1.f - alpha)), 2.f);
+    // Usually only one of the controls moves, the other's ramp is constant
+    // and only filled once
+    const bool driveSettled = driveSmoother.isSettled(firstChannel, numLanes);
+    const bool mixSettled = mixSmoother.isSettled(firstChannel, numLanes);
+    if (driveSettled) {
+        std::fill(driveRamp, driveRamp + rampSize, driveSmoother.getTarget());
     }
-    if (output > 1.f) {
-        output = (alpha + 1.f) / 2.f;
+    if (mixSettled) {
+        std::fill(mixRamp, mixRamp + rampSize, mixSmoother.getTarget());
     }
     
-    if (isNegative) {
-        output = -output;
+    for (int start = 0; start < numFrames; start += chunkFrames) {
+        const int chunkSize = std::min(chunkFrames, numFrames - start);
+        const int offset = start * numLanes;
+        
+        if (!driveSettled) {
+            driveSmoother.process(firstChannel, numLanes, driveRamp, chunkSize);
+        }
+        if (!mixSettled) {
+            mixSmoother.process(firstChannel, numLanes, mixRamp, chunkSize);
+        }
+        
+        if (useTable) {
+            kernelSet->modulatedTableKernels[interpolation](controls, *tables[mode], driveRamp, mixRamp,
+                                                            in + offset, out + offset, chunkSize * numLanes);
+        }
+        else {
+            kernelSet->modulatedKernels[getKernel(mode)](controls, driveRamp, mixRamp,
+                                                         in + offset, out + offset, chunkSize * numLanes);
+        }
     }
+}
+
+void Distortion::setSmoothing(ParameterSmoother::Shape shape, double seconds)
+{
+    smoothingShape = shape;
+    smoothingTime = seconds;
+    updateSmoothing();
+}
+
+/// Sets the smoothers up for the rate the nonlinearity runs at, and settles
+/// them on the current controls
+void Distortion::updateSmoothing()
+{
+    const double smoothingSamples = smoothingTime * sampleRate * oversampler.getFactor();
     
-    return output;
+    driveSmoother.setTarget(controls.drive);
+    mixSmoother.setTarget(controls.mix);
+    driveSmoother.setup(smoothingShape, smoothingSamples);
+    mixSmoother.setup(smoothingShape, smoothingSamples);
 }
 
+void Distortion::setCurveTables(CurveTables newCurveTables)
+{
+    curveTables = newCurveTables;
+}
 
-/** A nonlinearity by Laurent de Soras (allegedily)
+void Distortion::setAccuracy(Accuracy newAccuracy)
+{
+    accuracy = newAccuracy;
+}
 
-    This is very expensive, and someone recommended using
-    f(x) = x - 0.15 * x^2 - 0.15 * x^3 for a fast approximation.
- */
-float Distortion::gloubiBoulga(float sample)
+int Distortion::getKernel(int mode) const
+{
+    if (accuracy == fastAccuracy) {
+        switch (mode) {
+            case 2: return DistortionKernels::fastArctangentKernel;
+            case 8: return DistortionKernels::fastGloubiBoulgaKernel;
+            default: break;
+        }
+    }
+    return mode;
+}
+
+void Distortion::setAntialiasing(Antialiasing newAntialiasing)
+{
+    antialiasing = newAntialiasing;
+}
+
+void Distortion::setOversampling(int numStages, Oversampler::Quality quality)
+{
+    const int factor = oversampler.getFactor();
+    oversampler.setup(numStages, quality);
+    
+    if (oversampler.getFactor() != factor) {
+        updateSmoothing();
+    }
+}
+
+double Distortion::getLatencyInSamples() const
+{
+    // ADAA delays by half a sample per order, at the oversampled rate
+    const double antialiasingLatency = 0.5 * antialiasing / oversampler.getFactor();
+    return oversampler.getLatencyInSamples() + antialiasingLatency;
+}
+
+bool Distortion::isInterleavingWorthwhile() const
+{
+    return oversampler.getNumStages() != 0;
+}
+
+int Distortion::getTailLengthInSamples() const
 {
-    const double x = sample * 0.686306;
-    const double a = 1 + exp(sqrt(fabs(x)) * -0.75);
-    return (exp(x) - exp(-x * a)) / (exp(x) + exp(-x));
+    // The filters are linear phase, their impulse responses last twice their
+    // latency, and ADAA remembers the last order inputs
+    return static_cast<int>(std::ceil(2. * oversampler.getLatencyInSamples())) + antialiasing;
 }
 
-// Approximation based on description in gloubiBoulga
-float Distortion::gloubiApprox(float sample)
+int Distortion::getPreferredNumLanes() const
 {
-    return sample - (0.15f * sample * sample) - (0.15f * sample * sample * sample);
+    return std::min(std::max(kernelSet->vectorSize, 4), static_cast<int>(maxLanes));
 }
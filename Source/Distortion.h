@@ -3,14 +3,24 @@
 
 #include <cmath>
 
+#include "ChannelState.h"
+#include "Oversampler.h"
+#include "ParameterSmoother.h"
+#include "TransferTable.h"
+
+#include <memory>
+
 #define PI 3.14159265358979323846
 #define TAU 6.28318530717958647692
 
+namespace DistortionKernels { struct KernelSet; }
+
 class Distortion
 {
 public:
     struct Controls {
-        // Distortion mode, 0 = bypass, 1 = soft-clip, 2 = hard-clip
+        // Distortion mode, [0, numModes), 0 = bypass. Changes crossfade
+        // over 10 ms.
         int mode;
         // Drive, [1., ?), the amount of gain prior to the non-linearity
         float drive;
@@ -18,31 +28,260 @@ public:
         float threshold;
         // Mix, [0., 1.] ratio between a dry and wet signal
         float mix;
+        // Shape, [0., 1.], the alpha of the wave shaper modes 9 to 11
+        float shape;
     } controls;
     
     Distortion();
     ~Distortion();
+    
+    /** Prepares for playback
+     
+        Checks the CPU and binds the fastest kernels it supports, see
+        DistortionDispatch.h. Allocates and clears the state of numChannels
+        channels, nothing is allocated while processing.
+     */
+    void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+    
+    /// Clears the state of every channel
+    void reset();
+    
+    /** Processes a single sample of the first channel
+     
+        Only meant for tests and tools, it runs processBlock() on a block of
+        one sample and pays its per-block overhead every time. The stateful
+        stages see the sample like any other, so the output matches the same
+        samples processed in blocks. Audio code should process blocks.
+     */
     float processSample(float sample);
     
+    /** Processes a block of samples of one channel from in to out
+     
+        The nonlinearity is selected once for the whole block and the controls
+        are read once, so each mode runs in its own tight loop. The in and out
+        pointers may refer to the same buffer. The channel must be less than
+        the number of channels given to prepare(). Denormals are flushed to
+        zero while processing, see ScopedFlushDenormals.
+     */
+    void processBlock(int channel, const float* in, float* out, int numSamples);
+    
+    /// Processes a block of samples of one channel in place
+    void processBlock(int channel, float* samples, int numSamples);
+    
+    /** Processes a block of double precision samples of one channel from in
+        to out
+     
+        While nothing is being oversampled, anti-aliased, smoothed or
+        crossfaded the kernels run on the doubles directly. Otherwise the
+        samples go through the same stages as floats, a chunk at a time.
+     */
+    void processBlock(int channel, const double* in, double* out, int numSamples);
+    
+    /// Processes a block of double precision samples of one channel in place
+    void processBlock(int channel, double* samples, int numSamples);
+    
+    /** Processes a block of several channels at once, in place
+     
+        The frames hold numLanes interleaved channels, starting at firstChannel,
+        so each channel is a lane of the block. Neighbouring channels' state is
+        contiguous (see ChannelState), so stateful stages can work on all lanes
+        of a frame together instead of running one channel at a time. The
+        nonlinearity runs once over the whole block.
+     */
+    void processInterleaved(int firstChannel, int numLanes, float* frames, int numFrames);
+    
+    /// Returns the number of channels worth interleaving for the bound kernels,
+    /// at most maxLanes
+    int getPreferredNumLanes() const;
+    
+    /** Returns true if channels are faster processed interleaved than one at
+        a time, see processInterleaved()
+     
+        Only the oversampling filters gain from the lanes, the other stages
+        don't make up for the cost of interleaving the channels.
+     */
+    bool isInterleavingWorthwhile() const;
+    
+    /** Sets oversampling around the nonlinearity, 2^numStages times
+     
+        numStages is in [0, Oversampler::maxStages], 0 turns oversampling off.
+        The buffers for every factor are allocated by prepare(), so this can be
+        called between blocks on the audio thread. Changing the factor or
+        quality changes the latency and clears the filters.
+     */
+    void setOversampling(int numStages, Oversampler::Quality quality);
+    
+    /// Antiderivative anti-aliasing, see AntialiasedKernels.h
+    enum Antialiasing {
+        noAntialiasing,
+        firstOrderAntialiasing,
+        secondOrderAntialiasing
+    };
+    
+    /** Sets antiderivative anti-aliasing of the nonlinearity
+     
+        This suppresses aliasing without raising the sample rate, at the cost
+        of half a sample of latency per order. It combines with oversampling,
+        then it runs at the oversampled rate. Can be called between blocks on
+        the audio thread.
+     */
+    void setAntialiasing(Antialiasing newAntialiasing);
+    
+    /// How the expensive curves are evaluated, see TransferTable
+    enum CurveTables {
+        /// Computed per sample
+        noCurveTables,
+        /// Looked up with linear interpolation
+        linearCurveTables,
+        /// Looked up with cubic Hermite interpolation
+        hermiteCurveTables
+    };
+    
+    /** Sets how the expensive curves are evaluated, per sample by default
+     
+        The curves of the expensive modes (Gloubi-Boulga) are sampled when the
+        first Distortion is prepared and shared by all instances, evaluating
+        them then costs a few table lookups. That pays off on the scalar and
+        SSE kernels, but on AVX-512 the Hermite lookup is no faster than the
+        fast curve and less accurate. Can be called between blocks on the
+        audio thread.
+     */
+    void setCurveTables(CurveTables newCurveTables);
+    
+    /// How closely the transcendental curves computed per sample follow the
+    /// reference, see SimdVector.h
+    enum Accuracy {
+        /// Within a few ulp of the float reference
+        referenceAccuracy,
+        /// Minimax approximations with a bounded error, arctangent within
+        /// 7e-6 of the reference output and Gloubi-Boulga within 2e-5
+        fastAccuracy
+    };
+    
+    /** Sets how closely the curves follow the reference, reference by default
+     
+        Only changes the modes that have a fast approximation (arctangent and
+        Gloubi-Boulga), and only where they're computed per sample, not with
+        anti-aliasing on or in a table. Can be called between blocks on the
+        audio thread.
+     */
+    void setAccuracy(Accuracy newAccuracy);
+    
+    /** Sets how changes of the drive and mix are smoothed, linear ramps over
+        20 ms by default
+     
+        While they move, the kernels take them as per-sample ramps, and fall
+        back to the constant kernels once they settle. With anti-aliasing on
+        they move a block at a time. A time of 0 turns smoothing off.
+     */
+    void setSmoothing(ParameterSmoother::Shape shape, double seconds);
+    
+    /// The smoothing time in seconds until setSmoothing() is called
+    static const double defaultSmoothingTime;
+    
+    /// Returns the processing delay in samples, it's fractional when
+    /// oversampling by more than 2x or with first order anti-aliasing
+    double getLatencyInSamples() const;
+    
+    /// Returns the number of samples the output goes on for after the input
+    /// falls silent
+    int getTailLengthInSamples() const;
+    
+    /** Returns true if the output of numLanes channels from firstChannel is
+        their input, in bypass or with the mix at 0
+     
+        Processing these channels is then skipped, so callers can skip them
+        too. Only true without oversampling or anti-aliasing, which delay the
+        signal.
+     */
+    bool isTransparent(int firstChannel, int numLanes);
+    
+    /// Overrides the kernels bound by prepare(), the CPU must support them
+    void setKernelSet(const DistortionKernels::KernelSet& newKernelSet);
+    
+    /// Returns the name of the bound kernel set, e.g. "avx2"
+    const char* getKernelSetName() const;
+    
+    /// The number of distortion modes, including bypass
+    static const int numModes = 12;
+    
+    /// The maximum number of channels processed together as lanes
+    static const int maxLanes = 8;
+    
 private:
-    // Intermediate values
-    float input, output = 0.f;
-    float softClipThreshold = 2.f / 3.f;
-    
-    // Nonlinearities
-    float softClip(float sample);
-    float arctangent(float sample, float alpha);
-    float hardClip(float sample);
-    float squareLaw(float sample, float alpha);
-    float cubicWaveShaper(float sample);
-    
-    float foldback(float sample);
-    float waveShaper1(float sample, float alpha);
-    float waveShaper2(float sample, float alpha);
-    float waveShaper3(float sample, float alpha);
-    
-    float gloubiBoulga(float sample);
-    float gloubiApprox(float sample);
+    const DistortionKernels::KernelSet* kernelSet;
+    
+    // Per-channel state
+    enum StateVariable {
+        // The last two inputs of the nonlinearity, at its own rate
+        antialiasingInput1,
+        antialiasingInput2,
+        numStateVariables
+    };
+    ChannelState<float> state;
+    
+    // Per-channel modes and counters
+    enum IntegerStateVariable {
+        // The mode running, the mode fading out and the frames left to fade
+        crossfadeMode,
+        crossfadePreviousMode,
+        crossfadeRemaining,
+        // The number of consecutive silent input frames
+        silence,
+        numIntegerStateVariables
+    };
+    ChannelState<int> integerState;
+    
+    Oversampler oversampler;
+    int maximumBlockSize;
+    Antialiasing antialiasing;
+    
+    // The sampled curves of the expensive modes, shared with every other
+    // instance through TransferTableCache
+    std::shared_ptr<const TransferTable> tables[numModes];
+    CurveTables curveTables;
+    Accuracy accuracy;
+    
+    // Returns the index of a mode's kernels in the kernel set
+    int getKernel(int mode) const;
+    
+    template <typename Sample>
+    void processFrames(int firstChannel, int numLanes, const Sample* in, Sample* out, int numFrames);
+    void processStages(int mode, int firstChannel, int numLanes, const float* in, float* out, int numFrames);
+    void processStages(int mode, int firstChannel, int numLanes, const double* in, double* out, int numFrames);
+    bool isSteady(int firstChannel, int numLanes);
+    void processNonlinearity(int mode, int firstChannel, int numLanes,
+                             const float* in, float* out, int numFrames);
+    void processCrossfade(int previousMode, int mode, int position, int length,
+                          int firstChannel, int numLanes,
+                          const float* in, float* out, int numFrames);
+    void processMode(int mode, int firstChannel, int numLanes,
+                     const float* in, float* out, int numFrames);
+    void processConstant(int mode, const Controls& constantControls, int firstChannel, int numLanes,
+                         const float* in, float* out, int numFrames);
+    void processModulated(int mode, int firstChannel, int numLanes,
+                          const float* in, float* out, int numFrames);
+    
+    // Smoothing of the drive and mix, at the rate the nonlinearity runs at
+    ParameterSmoother driveSmoother;
+    ParameterSmoother mixSmoother;
+    ParameterSmoother::Shape smoothingShape;
+    double smoothingTime;
+    double sampleRate;
+    
+    void updateSmoothing();
+    void resetCrossfade();
+    
+    // The ramps of a chunk of a block, whole frames of up to maxLanes lanes
+    static const int rampSize = 256;
+    float driveRamp[rampSize];
+    float mixRamp[rampSize];
+    
+    // The output of the mode fading out, a chunk of a crossfade at a time
+    float crossfadeBuffer[rampSize];
+    
+    // Double precision samples converted to floats, a chunk at a time
+    float conversionBuffer[rampSize];
 };
 
 #endif  // DISTORTION_H_INCLUDED
@@ -0,0 +1,177 @@
+#include "DistortionDispatch.h"
+#include "DistortionKernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if DISTORTION_X86
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+#endif
+
+namespace DistortionKernels
+{
+namespace
+{
+    // The baseline kernels, built with the project's own compiler flags
+    const KernelSet scalarKernelSet = DISTORTION_KERNEL_SET("scalar", ScalarKernel<float>, ScalarKernel<double>);
+
+   #if DISTORTION_SIMD_SSE2
+    const KernelSet sse2KernelSet = DISTORTION_KERNEL_SET("sse2", SimdKernel<SseFloat>, SimdKernel<SseDouble>);
+   #endif
+}
+}
+
+namespace
+{
+    /// The instruction sets the CPU and operating system support
+    struct CpuFeatures
+    {
+        bool sse2 = false;
+        bool sse41 = false;
+        bool avx2 = false;
+        bool fma = false;
+        bool avx512 = false;
+
+        CpuFeatures()
+        {
+           #if DISTORTION_X86
+            unsigned int leaf1[4] = {}, leaf7[4] = {};
+            const unsigned int maximumLeaf = cpuid(0, 0, leaf1);
+            cpuid(1, 0, leaf1);
+            if (maximumLeaf >= 7) {
+                cpuid(7, 0, leaf7);
+            }
+
+            const unsigned int ecx1 = leaf1[2], edx1 = leaf1[3], ebx7 = leaf7[1];
+            sse2 = (edx1 & (1u << 26)) != 0;
+            sse41 = (ecx1 & (1u << 19)) != 0;
+
+            // The wider registers are only usable if the OS saves them on a
+            // context switch, which it reports through XCR0
+            const bool osxsave = (ecx1 & (1u << 27)) != 0;
+            const unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+            const bool osAvx = (xcr0 & 0x6) == 0x6;
+            const bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+
+            const bool avx = osAvx && (ecx1 & (1u << 28)) != 0;
+            avx2 = avx && (ebx7 & (1u << 5)) != 0;
+            fma = avx && (ecx1 & (1u << 12)) != 0;
+            avx512 = osAvx512 && (ebx7 & (1u << 16)) != 0;
+           #endif
+        }
+
+    private:
+       #if DISTORTION_X86
+        /// Runs cpuid, returns eax
+        static unsigned int cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+        {
+           #if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; ++i) {
+                registers[i] = static_cast<unsigned int>(r[i]);
+            }
+           #else
+            __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+           #endif
+            return registers[0];
+        }
+
+        static unsigned long long xgetbv()
+        {
+           #if defined(_MSC_VER)
+            return _xgetbv(0);
+           #else
+            unsigned int eax, edx;
+            __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+            return (static_cast<unsigned long long>(edx) << 32) | eax;
+           #endif
+        }
+       #endif
+    };
+
+    const CpuFeatures& getCpuFeatures()
+    {
+        static const CpuFeatures features;
+        return features;
+    }
+}
+
+const DistortionKernels::KernelSet* DistortionKernels::getScalarKernelSet()
+{
+    return &scalarKernelSet;
+}
+
+const DistortionKernels::KernelSet* DistortionKernels::getSse2KernelSet()
+{
+   #if DISTORTION_SIMD_SSE2
+    return &sse2KernelSet;
+   #else
+    return nullptr;
+   #endif
+}
+
+bool DistortionKernels::isSupported(const KernelSet* kernelSet)
+{
+    const CpuFeatures& cpu = getCpuFeatures();
+
+    if (kernelSet == nullptr) {
+        return false;
+    }
+    else if (kernelSet == getSse2KernelSet()) {
+        return cpu.sse2;
+    }
+    else if (kernelSet == getSse41KernelSet()) {
+        return cpu.sse41;
+    }
+    else if (kernelSet == getAvx2KernelSet()) {
+        return cpu.avx2 && cpu.fma;
+    }
+    else if (kernelSet == getAvx512KernelSet()) {
+        // Built with AVX2 and FMA as well, the compiler may use them anywhere
+        return cpu.avx512 && cpu.avx2 && cpu.fma;
+    }
+    else {
+        return kernelSet == getScalarKernelSet();
+    }
+}
+
+const DistortionKernels::KernelSet* DistortionKernels::findKernelSet(const char* name)
+{
+    const KernelSet* const kernelSets[] = {
+        getScalarKernelSet(), getSse2KernelSet(), getSse41KernelSet(),
+        getAvx2KernelSet(), getAvx512KernelSet()
+    };
+
+    for (const KernelSet* kernelSet : kernelSets) {
+        if (kernelSet != nullptr && std::strcmp(kernelSet->name, name) == 0) {
+            return isSupported(kernelSet) ? kernelSet : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+const DistortionKernels::KernelSet& DistortionKernels::selectKernelSet()
+{
+    if (const char* forced = std::getenv("DISTORTION_KERNELS")) {
+        if (const KernelSet* kernelSet = findKernelSet(forced)) {
+            return *kernelSet;
+        }
+    }
+
+    // Fastest first
+    const KernelSet* const kernelSets[] = {
+        getAvx512KernelSet(), getAvx2KernelSet(), getSse41KernelSet(), getSse2KernelSet()
+    };
+
+    for (const KernelSet* kernelSet : kernelSets) {
+        if (isSupported(kernelSet)) {
+            return *kernelSet;
+        }
+    }
+    return *getScalarKernelSet();
+}
@@ -0,0 +1,132 @@
+#ifndef DISTORTIONDISPATCH_H_INCLUDED
+#define DISTORTIONDISPATCH_H_INCLUDED
+
+#include "Distortion.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+ #define DISTORTION_X86 1
+#else
+ #define DISTORTION_X86 0
+#endif
+
+/**
+    Runtime selection of the distortion kernels.
+
+    The kernels in DistortionKernels.h are built several times, once per
+    instruction set, each in its own translation unit compiled for that
+    instruction set through target pragmas. So one binary carries every
+    variant, and the CPU is checked when the processor is prepared to pick the
+    fastest one it supports.
+
+    Setting the DISTORTION_KERNELS environment variable to the name of a kernel
+    set (scalar, sse2, sse4.1, avx2 or avx512) forces that set, provided the CPU
+    supports it. This is meant for A/B testing.
+ */
+namespace DistortionKernels
+{
+    /// The kernels past the modes' own, faster approximations of their curves
+    /// selected through Distortion::setAccuracy()
+    enum FastKernel {
+        fastArctangentKernel = Distortion::numModes,
+        fastGloubiBoulgaKernel,
+        numKernels
+    };
+
+    /// A block kernel, processes numSamples from in to out using the controls
+    typedef void (*BlockKernel)(const Distortion::Controls& controls,
+                                const float* in, float* out, int numSamples);
+
+    /// A table kernel, processes numSamples from in to out through a curve
+    /// sampled into a TransferTable
+    typedef void (*TableKernel)(const Distortion::Controls& controls, const TransferTable& table,
+                                const float* in, float* out, int numSamples);
+
+    /// A modulated kernel, like a BlockKernel with a drive and a mix per sample
+    typedef void (*ModulatedKernel)(const Distortion::Controls& controls,
+                                    const float* drive, const float* mix,
+                                    const float* in, float* out, int numSamples);
+
+    /// A modulated table kernel, like a TableKernel with a drive and a mix
+    /// per sample
+    typedef void (*ModulatedTableKernel)(const Distortion::Controls& controls, const TransferTable& table,
+                                         const float* drive, const float* mix,
+                                         const float* in, float* out, int numSamples);
+
+    /// An antialiased kernel, processes numFrames of numLanes from in to out.
+    /// previous and secondPrevious hold the last two inputs of each lane.
+    typedef void (*AntialiasedKernel)(const Distortion::Controls& controls,
+                                      const float* in, float* out,
+                                      int numFrames, int numLanes,
+                                      float* previous, float* secondPrevious);
+
+    /// A BlockKernel for double precision samples
+    typedef void (*DoubleBlockKernel)(const Distortion::Controls& controls,
+                                      const double* in, double* out, int numSamples);
+
+    /// A TableKernel for double precision samples
+    typedef void (*DoubleTableKernel)(const Distortion::Controls& controls, const TransferTable& table,
+                                      const double* in, double* out, int numSamples);
+
+    /// Kernels for every mode built for one instruction set
+    struct KernelSet
+    {
+        /// The name used to select this set, e.g. "avx2"
+        const char* name;
+
+        /// The number of samples processed per vector
+        int vectorSize;
+
+        /// Indexed by mode or FastKernel, then by whether the dry signal is
+        /// mixed in
+        BlockKernel kernels[numKernels][2];
+
+        /// Indexed by linear or Hermite interpolation, then like the kernels
+        TableKernel tableKernels[2][2];
+
+        /// Indexed by mode or FastKernel, used while the drive or mix are
+        /// smoothed
+        ModulatedKernel modulatedKernels[numKernels];
+
+        /// Indexed by linear or Hermite interpolation
+        ModulatedTableKernel modulatedTableKernels[2];
+
+        /// The filters of the oversampling stages
+        Oversampler::Convolution convolution;
+
+        /// Indexed by mode, then by ADAA order minus one, see
+        /// AntialiasedKernels.h
+        AntialiasedKernel antialiasedKernels[Distortion::numModes][2];
+
+        /// The number of double precision samples processed per vector
+        int doubleVectorSize;
+
+        /// Like the kernels, for double precision samples
+        DoubleBlockKernel doubleKernels[numKernels][2];
+
+        /// Like the table kernels, for double precision samples
+        DoubleTableKernel doubleTableKernels[2][2];
+    };
+
+    /// Returns the plain C++ kernels, these are always available
+    const KernelSet* getScalarKernelSet();
+
+    /// Returns the kernel set for an instruction set, or nullptr if it isn't
+    /// built for this architecture. Only call the kernels if the CPU supports
+    /// the instruction set, see isSupported().
+    const KernelSet* getSse2KernelSet();
+    const KernelSet* getSse41KernelSet();
+    const KernelSet* getAvx2KernelSet();
+    const KernelSet* getAvx512KernelSet();
+
+    /// Returns true if the kernel set is built and the CPU can run it
+    bool isSupported(const KernelSet* kernelSet);
+
+    /// Returns the supported kernel set with the given name, or nullptr
+    const KernelSet* findKernelSet(const char* name);
+
+    /// Returns the fastest supported kernel set, or the one forced through the
+    /// DISTORTION_KERNELS environment variable
+    const KernelSet& selectKernelSet();
+}
+
+#endif  // DISTORTIONDISPATCH_H_INCLUDED
@@ -0,0 +1,723 @@
+#ifndef DISTORTIONKERNELS_H_INCLUDED
+#define DISTORTIONKERNELS_H_INCLUDED
+
+#include "AntialiasedKernels.h"
+#include "Distortion.h"
+#include "DistortionDispatch.h"
+#include "SimdVector.h"
+
+#include <algorithm>
+
+/**
+    Block kernels for each distortion mode.
+
+    Every nonlinearity is a stateless functor constructed from the block's
+    controls and called with the dry input sample and the drive. The block loop
+    is a template over the functor, so each mode gets its own fully inlined loop
+    the compiler is free to vectorize. A second template argument drops the
+    dry/wet blend when the mix is fully wet.
+
+    While the drive or mix are being smoothed, the modulated kernels take them
+    as per-sample ramps instead.
+
+    The functors can also be called with the vector types from SimdVector.h,
+    processBlockSimd runs them a whole register at a time. Polynomial curves
+    share one template for floats and vectors, the transcendental ones keep the
+    reference float implementation next to the vector approximation.
+
+    Some curves also have a faster, coarser approximation as a kernel of its
+    own after the modes' kernels, see FastKernel and Distortion::setAccuracy().
+
+    This header is compiled once per instruction set (see DistortionDispatch.h),
+    so everything in it has internal linkage. Otherwise the linker could merge,
+    say, an AVX2 build of a functor into the SSE2 kernels.
+ */
+namespace DistortionKernels
+{
+namespace
+{
+    // Bypass, the dry signal is passed through
+    struct Bypass
+    {
+        explicit Bypass(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T) const
+        {
+            return input;
+        }
+    };
+
+    /** Cubic soft-clipping nonlinearity
+
+        Use 3x oversampling to eliminate aliasing
+     */
+    struct SoftClip
+    {
+        explicit SoftClip(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            const T cubic = sample - ((sample * sample * sample) / T(3.f));
+            return vselect(sample < T(-1.f), T(-2.f / 3.f),
+                           vselect(sample > T(1.f), T(2.f / 3.f), cubic));
+        }
+    };
+
+    // Arctangent nonlinearity
+    struct Arctangent
+    {
+        explicit Arctangent(const Distortion::Controls&) {}
+
+        float operator()(float input, float alpha) const
+        {
+            // f(x) = (2 / PI) * arctan(alpha * x[n]), where alpha >> 1 (drive param)
+            return (2.f / PI) * atan(alpha * input);
+        }
+
+        double operator()(double input, double alpha) const
+        {
+            return (2. / PI) * atan(alpha * input);
+        }
+
+        template <typename V>
+        V operator()(V input, V alpha) const
+        {
+            return V(static_cast<typename V::Sample>(2. / PI)) * vatan(alpha * input);
+        }
+    };
+
+    /// Arctangent through vatanFast, see Distortion::setAccuracy()
+    struct FastArctangent
+    {
+        explicit FastArctangent(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T alpha) const
+        {
+            return T(static_cast<float>(2. / PI)) * vatanFast(alpha * input);
+        }
+    };
+
+    // Hard-clipping nonlinearity
+    struct HardClip
+    {
+        explicit HardClip(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            return vmin(vmax(input * drive, T(-1.f)), T(1.f));
+        }
+    };
+
+    // Square law series expansion
+    struct SquareLaw
+    {
+        explicit SquareLaw(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T alpha) const
+        {
+            return input + alpha * input * input;
+        }
+    };
+
+    /** A cubic nonlinearity, input range: [-1, 1]?
+
+        Use 3x oversampling to eliminate aliasing
+     */
+    struct CubicWaveShaper
+    {
+        explicit CubicWaveShaper(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            return T(1.5f) * sample - T(0.5f) * sample * sample * sample;
+        }
+    };
+
+    /** Foldback nonlinearity, input range: (-inf, inf)
+
+        Reflects the driven signal back and forth between -threshold and
+        threshold.
+
+        Past the threshold this is a triangle wave of period 4 * threshold.
+        Measured in periods from the threshold it only needs a floor, so it
+        has no branch and vectorizes:
+
+            q = (sample - threshold) / (4 * threshold)
+            f = 4 * threshold * |q - floor(q) - 1/2| - threshold
+
+        The same as the fmod form within float rounding. Within the threshold
+        the sample passes through untouched.
+     */
+    struct Foldback
+    {
+        // Threshold should be > 0.f
+        const float threshold;
+        const float period;
+        const float inversePeriod;
+
+        explicit Foldback(const Distortion::Controls& controls)
+        : threshold(controls.threshold),
+          period(controls.threshold * 4.f),
+          inversePeriod(1.f / (controls.threshold * 4.f)) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            const T q = vmuladd(sample, T(inversePeriod), T(-0.25f));
+            const T folded = vmuladd(vabs(q - vfloor(q) - T(0.5f)), T(period), -T(threshold));
+            return vselect(vabs(sample) > T(threshold), folded, sample);
+        }
+    };
+
+    // Approximation based on description in GloubiBoulga
+    struct GloubiApprox
+    {
+        explicit GloubiApprox(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            return sample - (T(0.15f) * sample * sample) - (T(0.15f) * sample * sample * sample);
+        }
+    };
+
+    /** A nonlinearity by Laurent de Soras (allegedily)
+
+        This is very expensive, and someone recommended using
+        f(x) = x - 0.15 * x^2 - 0.15 * x^3 for a fast approximation.
+     */
+    struct GloubiBoulga
+    {
+        explicit GloubiBoulga(const Distortion::Controls&) {}
+
+        float operator()(float input, float drive) const
+        {
+            return static_cast<float>(curve(input * drive));
+        }
+
+        double operator()(double input, double drive) const
+        {
+            return curve(input * drive);
+        }
+
+        /// The curve as a function of drive * input, see TransferTable
+        static double curve(double sample)
+        {
+            const double x = sample * 0.686306;
+            const double a = 1 + exp(sqrt(fabs(x)) * -0.75);
+            return (exp(x) - exp(-x * a)) / (exp(x) + exp(-x));
+        }
+
+        template <typename V>
+        V operator()(V input, V drive) const
+        {
+            const V x = input * drive * V(static_cast<typename V::Sample>(0.686306));
+            const V a = V(1.f) + vexp(vsqrt(vabs(x)) * V(-0.75f));
+            const V ex = vexp(x);
+            return (ex - vexp(-x * a)) / (ex + vexp(-x));
+        }
+    };
+
+    /** Gloubi-Boulga through three vexpFast, see Distortion::setAccuracy()
+
+        The curve is rewritten over exponentials of arguments below 1, so it
+        can't overflow at any drive, with e^(-2|x|) shared by the numerator
+        and the denominator:
+
+            x >= 0:  (1 - e^(-x * a - x)) / (1 + e^(-2x))
+            x < 0:   (e^(2x) - e^(-x * a + x)) / (e^(2x) + 1)
+
+        With a = 1 + b, the second exponent is -x * b - (x + |x|), where
+        x + |x| is exact, so the large terms of -x * a and |x| don't cancel.
+        The square root in b is |x| times the vrsqrt estimate, refined by a
+        Newton step.
+     */
+    struct FastGloubiBoulga
+    {
+        explicit FastGloubiBoulga(const Distortion::Controls&) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T x = input * drive * T(0.686306f);
+            const T ax = vabs(x);
+
+            // Keeps 1 / sqrt finite at 0, where |x| zeroes the root anyway
+            const T guarded = vmax(ax, T(1e-30f));
+            T inverseRoot = vrsqrt(guarded);
+            inverseRoot = inverseRoot * vmuladd(T(-0.5f) * guarded, inverseRoot * inverseRoot, T(1.5f));
+
+            const T b = vexpFast(ax * inverseRoot * T(-0.75f));
+            const T u = vexpFast(ax * T(-2.f));
+            const T w = vexpFast(-x * b - (x + ax));
+            return (vselect(x < T(0.f), u, T(1.f)) - w) / (T(1.f) + u);
+        }
+    };
+
+    /// Returns the shape control limited to the range of alpha a curve is
+    /// defined over
+    inline float getAlpha(const Distortion::Controls& controls, float minimum, float maximum)
+    {
+        return std::min(std::max(controls.shape, minimum), maximum);
+    }
+
+    /** A nonlinearity by Partice Tarrabia and Bram de Jong,
+        (1 + k) * x / (1 + k * |x|) with k = 2 * alpha / (1 - alpha)
+
+        Linear at alpha 0, approaching a hard clip as alpha approaches 1.
+     */
+    struct WaveShaper1
+    {
+        const float k;
+        const float gain;
+
+        explicit WaveShaper1(const Distortion::Controls& controls)
+        : k(2.f * getAlpha(controls, 0.f, 0.99f) / (1.f - getAlpha(controls, 0.f, 0.99f))),
+          gain(1.f + k) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            return T(gain) * sample / vmuladd(T(k), vabs(sample), T(1.f));
+        }
+    };
+
+    /** A nonlinearity by Jon Watte, sin(PI * alpha * x) / sin(PI * alpha)
+
+        Held at the peak of the sine from x = 1 / (2 * alpha), and mirrored for
+        negative inputs. The original holds x at 1 only from 1 / alpha, where
+        the sine has fallen back to 0, and lets negative inputs wrap around.
+        Up to alpha 0.5 the curve passes through 1 at x = 1 and peaks beyond.
+        Past 0.5 its peak comes before x = 1 and would rise to
+        1 / sin(PI * alpha), so it's scaled to peak at 1 instead.
+     */
+    struct WaveShaper2
+    {
+        const float z;
+        const float scale;
+        const float limit;
+
+        explicit WaveShaper2(const Distortion::Controls& controls)
+        : z(static_cast<float>(PI * getAlpha(controls, 0.01f, 0.99f))),
+          scale(static_cast<float>(1. / std::sin(PI * getAlpha(controls, 0.01f, 0.5f)))),
+          limit(0.5f / getAlpha(controls, 0.01f, 0.99f)) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            const T shaped = vsin(T(z) * vmin(vabs(sample), T(limit))) * T(scale);
+            return vselect(sample < T(0.f), -shaped, shaped);
+        }
+    };
+
+    /** A nonlinearity by Bram de Jong, input range: [-1, 1]
+
+        Linear up to alpha, then alpha + d / (1 + (d / (1 - alpha))^2), with d
+        the distance past alpha, and held beyond 1 at (alpha + 1) / 2, where
+        the curve ends. Mirrored for negative inputs.
+     */
+    struct WaveShaper3
+    {
+        const float alpha;
+        const float inverseRange;
+        const float peak;
+
+        explicit WaveShaper3(const Distortion::Controls& controls)
+        : alpha(getAlpha(controls, 0.f, 0.99f)),
+          inverseRange(1.f / (1.f - alpha)),
+          peak((alpha + 1.f) / 2.f) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            const T sample = input * drive;
+            const T magnitude = vabs(sample);
+            const T excess = magnitude - T(alpha);
+            const T ratio = excess * T(inverseRange);
+            T shaped = vselect(magnitude > T(alpha), T(alpha) + excess / vmuladd(ratio, ratio, T(1.f)), magnitude);
+            shaped = vselect(magnitude > T(1.f), T(peak), shaped);
+            return vselect(sample < T(0.f), -shaped, shaped);
+        }
+    };
+
+    /** Finds the interval of a TransferTable an input falls in
+
+        Tabulated curves are functions of drive * input, so the drive doesn't
+        invalidate the table.
+     */
+    struct TableLookup
+    {
+        const float* coefficients;
+        const float scale;
+        const float offset;
+        const float last;
+
+        explicit TableLookup(const TransferTable& table)
+        : coefficients(table.getCoefficients()),
+          scale(table.getScale()),
+          offset(-table.getMinimum() * table.getScale()),
+          last(static_cast<float>(table.getNumPoints() - 1)) {}
+
+        /// Loads the coefficients of the interval, t is the position in it
+        template <typename T>
+        void operator()(T sample, T& t, T& y0, T& delta, T& k2, T& k3) const
+        {
+            const T position = vmin(vmax(vmuladd(sample, T(scale), T(offset)), T(0.f)), T(last));
+            const T index = vfloor(position);
+            t = position - index;
+            vgather4(coefficients, index, y0, delta, k2, k3);
+        }
+    };
+
+    /// A curve sampled into a TransferTable, with linear interpolation
+    struct LinearTableShaper
+    {
+        const TableLookup lookup;
+
+        explicit LinearTableShaper(const TransferTable& table) : lookup(table) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            T t, y0, delta, k2, k3;
+            lookup(input * drive, t, y0, delta, k2, k3);
+            return vmuladd(t, delta, y0);
+        }
+    };
+
+    /// A curve sampled into a TransferTable, with cubic Hermite interpolation
+    /// through the values and slopes of the neighbouring points
+    struct HermiteTableShaper
+    {
+        const TableLookup lookup;
+
+        explicit HermiteTableShaper(const TransferTable& table) : lookup(table) {}
+
+        template <typename T>
+        T operator()(T input, T drive) const
+        {
+            T t, y0, delta, k2, k3;
+            lookup(input * drive, t, y0, delta, k2, k3);
+            return vmuladd(t, vmuladd(t - T(1.f), vmuladd(k3, t, k2), delta), y0);
+        }
+    };
+
+    /// Runs a nonlinearity over a block of floats or doubles, blending with
+    /// the dry signal if HasMix
+    template <bool HasMix, typename Shaper, typename Sample>
+    void processBlockImpl(const Shaper& shaper, const Distortion::Controls& controls,
+                          const Sample* in, Sample* out, int numSamples)
+    {
+        const Sample drive = controls.drive;
+        const Sample wet = controls.mix;
+        const Sample dry = 1 - wet;
+
+        for (int i = 0; i < numSamples; ++i) {
+            const Sample input = in[i];
+            const Sample output = shaper(input, drive);
+            out[i] = HasMix ? dry * input + wet * output : output;
+        }
+    }
+
+    template <typename Shaper, bool HasMix, typename Sample>
+    void processBlockImpl(const Distortion::Controls& controls,
+                          const Sample* in, Sample* out, int numSamples)
+    {
+        processBlockImpl<HasMix>(Shaper(controls), controls, in, out, numSamples);
+    }
+
+    /// Runs a nonlinearity over a block V::size samples at a time, the
+    /// remainder goes through the scalar loop. The samples are floats or
+    /// doubles, like the vector's.
+    template <typename V, bool HasMix, typename Shaper>
+    void processBlockSimd(const Shaper& shaper, const Distortion::Controls& controls,
+                          const typename V::Sample* in, typename V::Sample* out, int numSamples)
+    {
+        typedef typename V::Sample Sample;
+        const V drive(static_cast<Sample>(controls.drive));
+        const V wet(static_cast<Sample>(controls.mix));
+        const V dry(1 - static_cast<Sample>(controls.mix));
+
+        int i = 0;
+        for (; i <= numSamples - V::size; i += V::size) {
+            const V input = V::load(in + i);
+            const V output = shaper(input, drive);
+            (HasMix ? dry * input + wet * output : output).store(out + i);
+        }
+
+        processBlockImpl<HasMix>(shaper, controls, in + i, out + i, numSamples - i);
+    }
+
+    template <typename V, typename Shaper, bool HasMix>
+    void processBlockSimd(const Distortion::Controls& controls,
+                          const typename V::Sample* in, typename V::Sample* out, int numSamples)
+    {
+        processBlockSimd<V, HasMix>(Shaper(controls), controls, in, out, numSamples);
+    }
+
+    /// Runs a nonlinearity over a block with a drive and a mix per sample
+    template <typename Shaper>
+    void processModulatedImpl(const Shaper& shaper, const float* drive, const float* mix,
+                              const float* in, float* out, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            const float input = in[i];
+            const float output = shaper(input, drive[i]);
+            out[i] = input + mix[i] * (output - input);
+        }
+    }
+
+    /// Runs a nonlinearity over a block with a drive and a mix per sample,
+    /// V::size samples at a time
+    template <typename V, typename Shaper>
+    void processModulatedSimd(const Shaper& shaper, const float* drive, const float* mix,
+                              const float* in, float* out, int numSamples)
+    {
+        int i = 0;
+        for (; i <= numSamples - V::size; i += V::size) {
+            const V input = V::load(in + i);
+            const V output = shaper(input, V::load(drive + i));
+            vmuladd(V::load(mix + i), output - input, input).store(out + i);
+        }
+
+        processModulatedImpl(shaper, drive + i, mix + i, in + i, out + i, numSamples - i);
+    }
+
+    /// Convolves a block with taps spaced stride samples apart,
+    /// out[i] = sum(taps[j] * in[i - j * stride]), see Oversampler
+    inline void convolveImpl(const float* taps, int numTaps, int stride,
+                             const float* in, float* out, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i) {
+            float sum = 0.f;
+            for (int j = 0; j < numTaps; ++j) {
+                sum += taps[j] * in[i - j * stride];
+            }
+            out[i] = sum;
+        }
+    }
+
+    /// Convolves a block like convolveImpl, four vectors of samples at a time.
+    /// Each tap is broadcast once for all four, and their sums stay in
+    /// registers until every tap is added.
+    template <typename V>
+    void convolveSimd(const float* taps, int numTaps, int stride,
+                      const float* in, float* out, int numSamples)
+    {
+        int i = 0;
+        for (; i <= numSamples - 4 * V::size; i += 4 * V::size) {
+            V sum0(0.f), sum1(0.f), sum2(0.f), sum3(0.f);
+            const float* x = in + i;
+            for (int j = 0; j < numTaps; ++j, x -= stride) {
+                const V tap(taps[j]);
+                sum0 = vmuladd(tap, V::load(x), sum0);
+                sum1 = vmuladd(tap, V::load(x + V::size), sum1);
+                sum2 = vmuladd(tap, V::load(x + 2 * V::size), sum2);
+                sum3 = vmuladd(tap, V::load(x + 3 * V::size), sum3);
+            }
+            sum0.store(out + i);
+            sum1.store(out + i + V::size);
+            sum2.store(out + i + 2 * V::size);
+            sum3.store(out + i + 3 * V::size);
+        }
+        for (; i <= numSamples - V::size; i += V::size) {
+            V sum(0.f);
+            const float* x = in + i;
+            for (int j = 0; j < numTaps; ++j, x -= stride) {
+                sum = vmuladd(V(taps[j]), V::load(x), sum);
+            }
+            sum.store(out + i);
+        }
+
+        convolveImpl(taps, numTaps, stride, in + i, out + i, numSamples - i);
+    }
+
+    /// Adapts processBlockImpl to the KernelSet tables, for floats or doubles.
+    /// The modulated kernels only take floats.
+    template <typename Sample>
+    struct ScalarKernel
+    {
+        typedef Sample Vector;
+        static const int size = 1;
+
+        template <typename Shaper, bool HasMix>
+        static void process(const Distortion::Controls& controls,
+                            const Sample* in, Sample* out, int numSamples)
+        {
+            processBlockImpl<Shaper, HasMix>(controls, in, out, numSamples);
+        }
+
+        template <typename TableShaper, bool HasMix>
+        static void processTable(const Distortion::Controls& controls, const TransferTable& table,
+                                 const Sample* in, Sample* out, int numSamples)
+        {
+            processBlockImpl<HasMix>(TableShaper(table), controls, in, out, numSamples);
+        }
+
+        template <typename Shaper>
+        static void processModulated(const Distortion::Controls& controls,
+                                     const float* drive, const float* mix,
+                                     const float* in, float* out, int numSamples)
+        {
+            processModulatedImpl(Shaper(controls), drive, mix, in, out, numSamples);
+        }
+
+        template <typename TableShaper>
+        static void processModulatedTable(const Distortion::Controls&, const TransferTable& table,
+                                          const float* drive, const float* mix,
+                                          const float* in, float* out, int numSamples)
+        {
+            processModulatedImpl(TableShaper(table), drive, mix, in, out, numSamples);
+        }
+
+        static void convolve(const float* taps, int numTaps, int stride,
+                             const float* in, float* out, int numSamples)
+        {
+            convolveImpl(taps, numTaps, stride, in, out, numSamples);
+        }
+    };
+
+    /// Adapts processBlockSimd to the KernelSet tables, for float or double
+    /// vectors. The modulated kernels only take float vectors.
+    template <typename V>
+    struct SimdKernel
+    {
+        typedef V Vector;
+        typedef typename V::Sample Sample;
+        static const int size = V::size;
+
+        template <typename Shaper, bool HasMix>
+        static void process(const Distortion::Controls& controls,
+                            const Sample* in, Sample* out, int numSamples)
+        {
+            processBlockSimd<V, Shaper, HasMix>(controls, in, out, numSamples);
+        }
+
+        template <typename TableShaper, bool HasMix>
+        static void processTable(const Distortion::Controls& controls, const TransferTable& table,
+                                 const Sample* in, Sample* out, int numSamples)
+        {
+            processBlockSimd<V, HasMix>(TableShaper(table), controls, in, out, numSamples);
+        }
+
+        template <typename Shaper>
+        static void processModulated(const Distortion::Controls& controls,
+                                     const float* drive, const float* mix,
+                                     const float* in, float* out, int numSamples)
+        {
+            processModulatedSimd<V>(Shaper(controls), drive, mix, in, out, numSamples);
+        }
+
+        template <typename TableShaper>
+        static void processModulatedTable(const Distortion::Controls&, const TransferTable& table,
+                                          const float* drive, const float* mix,
+                                          const float* in, float* out, int numSamples)
+        {
+            processModulatedSimd<V>(TableShaper(table), drive, mix, in, out, numSamples);
+        }
+
+        static void convolve(const float* taps, int numTaps, int stride,
+                             const float* in, float* out, int numSamples)
+        {
+            convolveSimd<V>(taps, numTaps, stride, in, out, numSamples);
+        }
+    };
+}
+}
+
+/** Initializer for a KernelSet, Kernel is a float ScalarKernel or SimdKernel
+    and DoubleKernel its double counterpart
+
+    The table only holds function addresses, so a KernelSet initialized with
+    this is constant-initialized and no code built for the kernel's instruction
+    set runs until one of its kernels is called.
+ */
+#define DISTORTION_KERNEL_SET(kernelSetName, Kernel, DoubleKernel) \
+    { kernelSetName, Kernel::size, { \
+        { Kernel::process<Bypass, false>,          Kernel::process<Bypass, false> }, \
+        { Kernel::process<SoftClip, false>,        Kernel::process<SoftClip, true> }, \
+        { Kernel::process<Arctangent, false>,      Kernel::process<Arctangent, true> }, \
+        { Kernel::process<HardClip, false>,        Kernel::process<HardClip, true> }, \
+        { Kernel::process<SquareLaw, false>,       Kernel::process<SquareLaw, true> }, \
+        { Kernel::process<CubicWaveShaper, false>, Kernel::process<CubicWaveShaper, true> }, \
+        { Kernel::process<Foldback, false>,        Kernel::process<Foldback, true> }, \
+        { Kernel::process<GloubiApprox, false>,    Kernel::process<GloubiApprox, true> }, \
+        { Kernel::process<GloubiBoulga, false>,    Kernel::process<GloubiBoulga, true> }, \
+        { Kernel::process<WaveShaper1, false>,     Kernel::process<WaveShaper1, true> }, \
+        { Kernel::process<WaveShaper2, false>,     Kernel::process<WaveShaper2, true> }, \
+        { Kernel::process<WaveShaper3, false>,     Kernel::process<WaveShaper3, true> }, \
+        { Kernel::process<FastArctangent, false>,  Kernel::process<FastArctangent, true> }, \
+        { Kernel::process<FastGloubiBoulga, false>, Kernel::process<FastGloubiBoulga, true> } \
+    }, { \
+        { Kernel::processTable<LinearTableShaper, false>,  Kernel::processTable<LinearTableShaper, true> }, \
+        { Kernel::processTable<HermiteTableShaper, false>, Kernel::processTable<HermiteTableShaper, true> } \
+    }, { \
+        Kernel::processModulated<Bypass>, \
+        Kernel::processModulated<SoftClip>, \
+        Kernel::processModulated<Arctangent>, \
+        Kernel::processModulated<HardClip>, \
+        Kernel::processModulated<SquareLaw>, \
+        Kernel::processModulated<CubicWaveShaper>, \
+        Kernel::processModulated<Foldback>, \
+        Kernel::processModulated<GloubiApprox>, \
+        Kernel::processModulated<GloubiBoulga>, \
+        Kernel::processModulated<WaveShaper1>, \
+        Kernel::processModulated<WaveShaper2>, \
+        Kernel::processModulated<WaveShaper3>, \
+        Kernel::processModulated<FastArctangent>, \
+        Kernel::processModulated<FastGloubiBoulga> \
+    }, { \
+        Kernel::processModulatedTable<LinearTableShaper>, \
+        Kernel::processModulatedTable<HermiteTableShaper> \
+    }, Kernel::convolve, { \
+        { processDelayed<Kernel, Bypass, 1>, processDelayed<Kernel, Bypass, 2> }, \
+        { processFirstOrder<DoubleKernel::Vector, SoftClipAdaa>, \
+          processSecondOrder<DoubleKernel::Vector, SoftClipAdaa> }, \
+        { processFirstOrder<DoubleKernel::Vector, ArctangentAdaa>, \
+          processSecondOrder<DoubleKernel::Vector, ArctangentAdaa> }, \
+        { processFirstOrder<DoubleKernel::Vector, HardClipAdaa>, \
+          processSecondOrder<DoubleKernel::Vector, HardClipAdaa> }, \
+        { processFirstOrder<DoubleKernel::Vector, SquareLawAdaa>, \
+          processSecondOrder<DoubleKernel::Vector, SquareLawAdaa> }, \
+        { processFirstOrder<DoubleKernel::Vector, CubicWaveShaperAdaa>, \
+          processSecondOrder<DoubleKernel::Vector, CubicWaveShaperAdaa> }, \
+        { processDelayed<Kernel, Foldback, 1>, processDelayed<Kernel, Foldback, 2> }, \
+        { processFirstOrder<DoubleKernel::Vector, GloubiApproxAdaa>, \
+          processSecondOrder<DoubleKernel::Vector, GloubiApproxAdaa> }, \
+        { processDelayed<Kernel, GloubiBoulga, 1>, processDelayed<Kernel, GloubiBoulga, 2> }, \
+        { processDelayed<Kernel, WaveShaper1, 1>, processDelayed<Kernel, WaveShaper1, 2> }, \
+        { processDelayed<Kernel, WaveShaper2, 1>, processDelayed<Kernel, WaveShaper2, 2> }, \
+        { processDelayed<Kernel, WaveShaper3, 1>, processDelayed<Kernel, WaveShaper3, 2> } \
+    }, DoubleKernel::size, { \
+        { DoubleKernel::process<Bypass, false>,          DoubleKernel::process<Bypass, false> }, \
+        { DoubleKernel::process<SoftClip, false>,        DoubleKernel::process<SoftClip, true> }, \
+        { DoubleKernel::process<Arctangent, false>,      DoubleKernel::process<Arctangent, true> }, \
+        { DoubleKernel::process<HardClip, false>,        DoubleKernel::process<HardClip, true> }, \
+        { DoubleKernel::process<SquareLaw, false>,       DoubleKernel::process<SquareLaw, true> }, \
+        { DoubleKernel::process<CubicWaveShaper, false>, DoubleKernel::process<CubicWaveShaper, true> }, \
+        { DoubleKernel::process<Foldback, false>,        DoubleKernel::process<Foldback, true> }, \
+        { DoubleKernel::process<GloubiApprox, false>,    DoubleKernel::process<GloubiApprox, true> }, \
+        { DoubleKernel::process<GloubiBoulga, false>,    DoubleKernel::process<GloubiBoulga, true> }, \
+        { DoubleKernel::process<WaveShaper1, false>,     DoubleKernel::process<WaveShaper1, true> }, \
+        { DoubleKernel::process<WaveShaper2, false>,     DoubleKernel::process<WaveShaper2, true> }, \
+        { DoubleKernel::process<WaveShaper3, false>,     DoubleKernel::process<WaveShaper3, true> }, \
+        { DoubleKernel::process<FastArctangent, false>,  DoubleKernel::process<FastArctangent, true> }, \
+        { DoubleKernel::process<FastGloubiBoulga, false>, DoubleKernel::process<FastGloubiBoulga, true> } \
+    }, { \
+        { DoubleKernel::processTable<LinearTableShaper, false>,  DoubleKernel::processTable<LinearTableShaper, true> }, \
+        { DoubleKernel::processTable<HermiteTableShaper, false>, DoubleKernel::processTable<HermiteTableShaper, true> } \
+    } }
+
+#endif  // DISTORTIONKERNELS_H_INCLUDED
@@ -0,0 +1,51 @@
+/**
+    The distortion kernels built for AVX2 and FMA.
+
+    Eight floats per iteration, with fused multiply-adds in the polynomials.
+    Only called when the CPU supports it, see DistortionDispatch.h.
+ */
+
+#include "DistortionDispatch.h"
+
+#if DISTORTION_X86
+ // Standard headers are included before the target pragma, so nothing from
+ // them is built for AVX2 and FMA
+ #include <cmath>
+ #include <immintrin.h>
+
+ #if defined(__clang__)
+  #pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+ #elif defined(__GNUC__)
+  #pragma GCC push_options
+  #pragma GCC target("avx2,fma")
+ #endif
+
+ #define DISTORTION_SIMD_SSE2 1
+ #define DISTORTION_SIMD_SSE41 1
+ #define DISTORTION_SIMD_AVX2 1
+ #define DISTORTION_SIMD_FMA 1
+ #include "DistortionKernels.h"
+
+namespace DistortionKernels
+{
+namespace
+{
+    const KernelSet avx2KernelSet = DISTORTION_KERNEL_SET("avx2", SimdKernel<AvxFloat>, SimdKernel<AvxDouble>);
+}
+}
+
+ #if defined(__clang__)
+  #pragma clang attribute pop
+ #elif defined(__GNUC__)
+  #pragma GCC pop_options
+ #endif
+#endif
+
+const DistortionKernels::KernelSet* DistortionKernels::getAvx2KernelSet()
+{
+   #if DISTORTION_X86
+    return &avx2KernelSet;
+   #else
+    return nullptr;
+   #endif
+}
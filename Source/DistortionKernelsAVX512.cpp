@@ -0,0 +1,56 @@
+/**
+    The distortion kernels built for AVX-512.
+
+    Sixteen floats per iteration, comparisons go through mask registers.
+    Only called when the CPU supports it, see DistortionDispatch.h.
+ */
+
+#include "DistortionDispatch.h"
+
+#if DISTORTION_X86
+ // Standard headers are included before the target pragma, so nothing from
+ // them is built for AVX-512
+ #include <cmath>
+ #include <immintrin.h>
+
+ #if defined(__clang__)
+  #pragma clang attribute push (__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+ #elif defined(__GNUC__)
+  #pragma GCC push_options
+  #pragma GCC target("avx512f,avx2,fma")
+  // GCC 12's AVX-512 headers trip this on their own _mm512_undefined_ps()
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wuninitialized"
+ #endif
+
+ #define DISTORTION_SIMD_SSE2 1
+ #define DISTORTION_SIMD_SSE41 1
+ #define DISTORTION_SIMD_AVX2 1
+ #define DISTORTION_SIMD_FMA 1
+ #define DISTORTION_SIMD_AVX512 1
+ #include "DistortionKernels.h"
+
+namespace DistortionKernels
+{
+namespace
+{
+    const KernelSet avx512KernelSet = DISTORTION_KERNEL_SET("avx512", SimdKernel<Avx512Float>, SimdKernel<Avx512Double>);
+}
+}
+
+ #if defined(__clang__)
+  #pragma clang attribute pop
+ #elif defined(__GNUC__)
+  #pragma GCC diagnostic pop
+  #pragma GCC pop_options
+ #endif
+#endif
+
+const DistortionKernels::KernelSet* DistortionKernels::getAvx512KernelSet()
+{
+   #if DISTORTION_X86
+    return &avx512KernelSet;
+   #else
+    return nullptr;
+   #endif
+}
@@ -0,0 +1,49 @@
+/**
+    The distortion kernels built for SSE4.1.
+
+    SSE4.1 adds blendv and round, which the select, floor and trunc of SseFloat use.
+    Only called when the CPU supports it, see DistortionDispatch.h.
+ */
+
+#include "DistortionDispatch.h"
+
+#if DISTORTION_X86
+ // Standard headers are included before the target pragma, so nothing from
+ // them is built for SSE4.1
+ #include <cmath>
+ #include <immintrin.h>
+
+ #if defined(__clang__)
+  #pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+ #elif defined(__GNUC__)
+  #pragma GCC push_options
+  #pragma GCC target("sse4.1")
+ #endif
+
+ #define DISTORTION_SIMD_SSE2 1
+ #define DISTORTION_SIMD_SSE41 1
+ #include "DistortionKernels.h"
+
+namespace DistortionKernels
+{
+namespace
+{
+    const KernelSet sse41KernelSet = DISTORTION_KERNEL_SET("sse4.1", SimdKernel<SseFloat>, SimdKernel<SseDouble>);
+}
+}
+
+ #if defined(__clang__)
+  #pragma clang attribute pop
+ #elif defined(__GNUC__)
+  #pragma GCC pop_options
+ #endif
+#endif
+
+const DistortionKernels::KernelSet* DistortionKernels::getSse41KernelSet()
+{
+   #if DISTORTION_X86
+    return &sse41KernelSet;
+   #else
+    return nullptr;
+   #endif
+}
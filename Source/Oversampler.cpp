@@ -0,0 +1,306 @@
+#include "Oversampler.h"
+#include "DistortionDispatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Half the filter length of each stage, by quality. Must be odd so the
+    // end taps of the halfband filter are nonzero.
+    //
+    // At 48 kHz the first stage has to pass 20 kHz and reject the images from
+    // 28 kHz, a narrow transition only long filters manage: about 60, 73 and
+    // 90 dB by quality, all within 0.01 dB up to 20 kHz. The later stages
+    // have room up to their own images, the shorter filters keep 40 to 80 dB
+    // there and lose at most 0.2 dB at 20 kHz.
+    const int stageOrders[3][Oversampler::maxStages] = {
+        { 27, 5, 3, 3 },
+        { 33, 7, 5, 3 },
+        { 39, 9, 7, 5 }
+    };
+
+    // Kaiser window beta by quality
+    const double kaiserBetas[3] = { 5., 7., 9. };
+
+    const int maxOrder = 39;
+
+    const double pi = 3.14159265358979323846;
+
+    /// Zeroth order modified Bessel function of the first kind
+    double besselI0(double x)
+    {
+        double sum = 1., term = 1.;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2. * k)) * (x / (2. * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    /** Interleaves the frames of the two phases of an upsampled block, twice
+        the convolution phase then the delay phase
+
+        The lanes are a template argument where they can be, 0 takes numLanes,
+        so the loops over them unroll and the compiler can vectorize the whole
+        block.
+     */
+    template <int fixedNumLanes>
+    void mergePhases(const float* convolved, const float* delayed, float* out, int numFrames, int numLanes)
+    {
+        const int lanes = fixedNumLanes > 0 ? fixedNumLanes : numLanes;
+        for (int frame = 0; frame < numFrames; ++frame) {
+            float* const even = out + 2 * frame * lanes;
+            float* const odd = even + lanes;
+            for (int lane = 0; lane < lanes; ++lane) {
+                even[lane] = 2.f * convolved[frame * lanes + lane];
+                odd[lane] = delayed[frame * lanes + lane];
+            }
+        }
+    }
+
+    /// Splits the frames of a block into its even and odd phases, the lanes
+    /// like mergePhases()
+    template <int fixedNumLanes>
+    void splitPhases(const float* in, float* even, float* odd, int numFrames, int numLanes)
+    {
+        const int lanes = fixedNumLanes > 0 ? fixedNumLanes : numLanes;
+        for (int frame = 0; frame < numFrames; ++frame) {
+            const float* const input = in + 2 * frame * lanes;
+            for (int lane = 0; lane < lanes; ++lane) {
+                even[frame * lanes + lane] = input[lane];
+                odd[frame * lanes + lane] = input[lanes + lane];
+            }
+        }
+    }
+}
+
+Oversampler::Oversampler()
+: numStages(0), quality(medium), numChannels(0),
+  convolution(DistortionKernels::getScalarKernelSet()->convolution)
+{
+}
+
+void Oversampler::setConvolution(Convolution newConvolution)
+{
+    convolution = newConvolution;
+}
+
+void Oversampler::prepare(int maximumBlockSize, int maximumNumLanes, int newNumChannels)
+{
+    numChannels = newNumChannels;
+
+    for (int i = 0; i < maxStages; ++i) {
+        Stage& stage = stages[i];
+        stage.coefficients.reserve(maxOrder + 1);
+        stage.upHistory.setSize(maxOrder, numChannels);
+        stage.downEvenHistory.setSize(maxOrder, numChannels);
+        stage.downOddHistory.setSize((maxOrder + 1) / 2, numChannels);
+
+        buffers[i].assign(static_cast<size_t>(maximumBlockSize << (i + 1)) * maximumNumLanes, 0.f);
+    }
+
+    // The convolutions run on the input of a stage, at most half the highest rate
+    const size_t workSize = static_cast<size_t>((maximumBlockSize << (maxStages - 1)) + maxOrder)
+                            * maximumNumLanes;
+    workA.assign(workSize, 0.f);
+    workB.assign(workSize, 0.f);
+
+    designStages();
+}
+
+void Oversampler::setup(int newNumStages, Quality newQuality)
+{
+    if (newNumStages < 0) {
+        newNumStages = 0;
+    }
+    else if (newNumStages > maxStages) {
+        newNumStages = maxStages;
+    }
+
+    if (newNumStages == numStages && newQuality == quality) {
+        return;
+    }
+
+    numStages = newNumStages;
+    quality = newQuality;
+    designStages();
+}
+
+void Oversampler::designStages()
+{
+    for (int i = 0; i < numStages; ++i) {
+        design(stages[i], stageOrders[quality][i], kaiserBetas[quality]);
+    }
+    reset();
+}
+
+void Oversampler::reset()
+{
+    for (int i = 0; i < maxStages; ++i) {
+        stages[i].upHistory.reset();
+        stages[i].downEvenHistory.reset();
+        stages[i].downOddHistory.reset();
+    }
+}
+
+double Oversampler::getLatencyInSamples() const
+{
+    // Both filters of a stage delay by its order at the doubled rate, which is
+    // the order at the stage's input rate
+    double latency = 0.;
+    for (int i = 0; i < numStages; ++i) {
+        latency += static_cast<double>(stages[i].order) / (1 << i);
+    }
+    return latency;
+}
+
+/**
+    Designs a Kaiser windowed sinc halfband filter of length 2 * order + 1.
+
+    Only the taps of the convolution phase are stored, the centre tap is always
+    1/2 and the other taps of its phase are zero.
+ */
+void Oversampler::design(Stage& stage, int order, double beta)
+{
+    stage.order = order;
+    stage.coefficients.resize(static_cast<size_t>(order + 1));
+
+    double sum = 0.;
+    for (int j = 0; j <= order; ++j) {
+        const double t = (2 * j - order) / 2.;
+        const double r = (2 * j - order) / static_cast<double>(order);
+        const double window = besselI0(beta * std::sqrt(1. - r * r)) / besselI0(beta);
+        const double h = 0.5 * std::sin(pi * t) / (pi * t) * window;
+        stage.coefficients[j] = static_cast<float>(h);
+        sum += h;
+    }
+
+    // Unity gain at DC, the phase sums to 1/2 like the centre tap
+    for (int j = 0; j <= order; ++j) {
+        stage.coefficients[j] = static_cast<float>(stage.coefficients[j] * 0.5 / sum);
+    }
+}
+
+/**
+    Doubles the rate of a block.
+
+    With x the input and h the halfband filter, the outputs are
+        y[2n]     = 2 * sum(h[2j] * x[n - j])
+        y[2n + 1] = x[n - (order - 1) / 2]
+ */
+void Oversampler::upsample(Stage& stage, int firstChannel, int numLanes,
+                           const float* in, float* out, int numFrames)
+{
+    const int order = stage.order;
+    const int numSamples = numFrames * numLanes;
+    float* const history = workA.data();
+    float* const accumulator = workB.data();
+
+    // Filter history followed by the block
+    for (int t = 0; t < order; ++t) {
+        const float* variable = stage.upHistory.getVariable(t) + firstChannel;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            history[t * numLanes + lane] = variable[lane];
+        }
+    }
+    const float* const x = history + order * numLanes;
+    std::copy(in, in + numSamples, history + order * numLanes);
+
+    for (int t = 0; t < order; ++t) {
+        float* variable = stage.upHistory.getVariable(t) + firstChannel;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            variable[lane] = history[(numFrames + t) * numLanes + lane];
+        }
+    }
+
+    // The convolution phase
+    convolution(stage.coefficients.data(), order + 1, numLanes, x, accumulator, numSamples);
+
+    // Interleave with the delay phase
+    const float* const delayed = x - ((order - 1) / 2) * numLanes;
+    switch (numLanes) {
+        case 1:  mergePhases<1>(accumulator, delayed, out, numFrames, 1); break;
+        case 2:  mergePhases<2>(accumulator, delayed, out, numFrames, 2); break;
+        case 4:  mergePhases<4>(accumulator, delayed, out, numFrames, 4); break;
+        case 8:  mergePhases<8>(accumulator, delayed, out, numFrames, 8); break;
+        default: mergePhases<0>(accumulator, delayed, out, numFrames, numLanes); break;
+    }
+}
+
+/**
+    Halves the rate of a block, numFrames is the number of output frames.
+
+    With e and o the even and odd phases of the input, the outputs are
+        y[n] = sum(h[2j] * e[n - j]) + o[n - (order + 1) / 2] / 2
+ */
+void Oversampler::downsample(Stage& stage, int firstChannel, int numLanes,
+                             const float* in, float* out, int numFrames)
+{
+    const int order = stage.order;
+    const int oddDelay = (order + 1) / 2;
+    const int numSamples = numFrames * numLanes;
+    float* const evenHistory = workA.data();
+    float* const oddHistory = workB.data();
+
+    for (int t = 0; t < order; ++t) {
+        const float* variable = stage.downEvenHistory.getVariable(t) + firstChannel;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            evenHistory[t * numLanes + lane] = variable[lane];
+        }
+    }
+    for (int t = 0; t < oddDelay; ++t) {
+        const float* variable = stage.downOddHistory.getVariable(t) + firstChannel;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            oddHistory[t * numLanes + lane] = variable[lane];
+        }
+    }
+
+    // Split the phases behind their history
+    float* const even = evenHistory + order * numLanes;
+    float* const odd = oddHistory + oddDelay * numLanes;
+    switch (numLanes) {
+        case 1:  splitPhases<1>(in, even, odd, numFrames, 1); break;
+        case 2:  splitPhases<2>(in, even, odd, numFrames, 2); break;
+        case 4:  splitPhases<4>(in, even, odd, numFrames, 4); break;
+        case 8:  splitPhases<8>(in, even, odd, numFrames, 8); break;
+        default: splitPhases<0>(in, even, odd, numFrames, numLanes); break;
+    }
+
+    for (int t = 0; t < order; ++t) {
+        float* variable = stage.downEvenHistory.getVariable(t) + firstChannel;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            variable[lane] = evenHistory[(numFrames + t) * numLanes + lane];
+        }
+    }
+    for (int t = 0; t < oddDelay; ++t) {
+        float* variable = stage.downOddHistory.getVariable(t) + firstChannel;
+        for (int lane = 0; lane < numLanes; ++lane) {
+            variable[lane] = oddHistory[(numFrames + t) * numLanes + lane];
+        }
+    }
+
+    // The delayed odd phase starts at the beginning of its history
+    convolution(stage.coefficients.data(), order + 1, numLanes, even, out, numSamples);
+    for (int i = 0; i < numSamples; ++i) {
+        out[i] += 0.5f * oddHistory[i];
+    }
+}
+
+float* Oversampler::processUp(int firstChannel, int numLanes, const float* in, int numFrames)
+{
+    const float* source = in;
+    for (int i = 0; i < numStages; ++i) {
+        upsample(stages[i], firstChannel, numLanes, source, buffers[i].data(), numFrames << i);
+        source = buffers[i].data();
+    }
+    return numStages > 0 ? buffers[numStages - 1].data() : nullptr;
+}
+
+void Oversampler::processDown(int firstChannel, int numLanes, float* out, int numFrames)
+{
+    for (int i = numStages - 1; i >= 0; --i) {
+        float* destination = i > 0 ? buffers[i - 1].data() : out;
+        downsample(stages[i], firstChannel, numLanes, buffers[i].data(), destination, numFrames << i);
+    }
+}
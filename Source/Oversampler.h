@@ -0,0 +1,116 @@
+#ifndef OVERSAMPLER_H_INCLUDED
+#define OVERSAMPLER_H_INCLUDED
+
+#include <vector>
+
+#include "ChannelState.h"
+
+/**
+    Polyphase halfband oversampling from 2x up to 16x.
+
+    Each doubling of the rate is a stage with a linear-phase halfband FIR for
+    upsampling and another for downsampling. All even-offset taps of a halfband
+    filter are zero except the centre one, which is 1/2, so in polyphase form
+    one output phase is a plain delay and only the other phase needs a
+    convolution. Later stages see a signal that is already band-limited and
+    get away with shorter filters.
+
+    Blocks are frames of interleaved lanes, one lane per channel, as in
+    Distortion::processInterleaved. A single channel is one lane. The filter
+    history is kept per channel in ChannelState, so any grouping of channels
+    into lanes can be used from block to block.
+
+    All memory is allocated by prepare().
+ */
+class Oversampler
+{
+public:
+    /// Filter quality, trades stopband rejection for taps and latency
+    enum Quality {
+        low,
+        medium,
+        high
+    };
+
+    /// The maximum number of stages, 16x oversampling
+    static const int maxStages = 4;
+
+    /// Convolves a block with taps spaced stride samples apart,
+    /// out[i] = sum(taps[j] * in[i - j * stride])
+    typedef void (*Convolution)(const float* taps, int numTaps, int stride,
+                                const float* in, float* out, int numSamples);
+
+    Oversampler();
+
+    /// Sets the convolution the filters run on, the scalar kernel set's by
+    /// default. Distortion passes on the one of its kernel set.
+    void setConvolution(Convolution newConvolution);
+
+    /** Allocates buffers for blocks of up to maximumBlockSize frames and up to
+        maximumNumLanes lanes, for any number of stages and quality.
+     */
+    void prepare(int maximumBlockSize, int maximumNumLanes, int numChannels);
+
+    /// Sets the number of stages, [0, maxStages], and the quality. Clears the
+    /// filter history if either changes. Doesn't allocate.
+    void setup(int numStages, Quality quality);
+
+    /// Clears the filter history of every channel
+    void reset();
+
+    /// Returns the number of stages, 0 when not oversampling
+    int getNumStages() const { return numStages; }
+
+    /// Returns the oversampling factor, 2^stages
+    int getFactor() const { return 1 << numStages; }
+
+    /// Returns the delay of upsampling then downsampling, in samples at the
+    /// base rate. This is fractional for more than one stage.
+    double getLatencyInSamples() const;
+
+    /** Upsamples a block and returns the oversampled frames
+
+        The result holds numFrames * getFactor() frames of numLanes lanes and
+        stays valid until the next call. It can be processed in place before
+        passing it to processDown().
+     */
+    float* processUp(int firstChannel, int numLanes, const float* in, int numFrames);
+
+    /// Downsamples the frames returned by processUp() into out
+    void processDown(int firstChannel, int numLanes, float* out, int numFrames);
+
+private:
+    /// One halfband filter pair, the input rate is doubled
+    struct Stage
+    {
+        // The taps of the convolution phase, h[0], h[2], ..., h[2 * order]
+        std::vector<float> coefficients;
+        // Half the filter length, odd, the delay in samples at the doubled rate
+        int order = 0;
+        // Upsampler history, order frames
+        ChannelState<float> upHistory;
+        // Downsampler history of the even and odd phases
+        ChannelState<float> downEvenHistory;
+        ChannelState<float> downOddHistory;
+    };
+
+    void designStages();
+    void design(Stage& stage, int order, double beta);
+    void upsample(Stage& stage, int firstChannel, int numLanes,
+                  const float* in, float* out, int numFrames);
+    void downsample(Stage& stage, int firstChannel, int numLanes,
+                    const float* in, float* out, int numFrames);
+
+    Stage stages[maxStages];
+    int numStages;
+    Quality quality;
+    int numChannels;
+    Convolution convolution;
+
+    // buffers[i] holds the output of upsampling stage i
+    std::vector<float> buffers[maxStages];
+    // Filter history followed by input, for the convolutions
+    std::vector<float> workA, workB;
+};
+
+#endif  // OVERSAMPLER_H_INCLUDED
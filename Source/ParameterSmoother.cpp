@@ -0,0 +1,162 @@
+#include "ParameterSmoother.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // The exponential ramp snaps to the target within this, relative to the
+    // size of the change
+    const float exponentialTolerance = 1e-4f;
+    
+    /// Writes start + step * (frame + 1) to every stride-th float
+    void fillLinear(float* ramp, int stride, int numFrames, float start, float step)
+    {
+        // Split so the contiguous case vectorizes
+        if (stride == 1) {
+            for (int frame = 0; frame < numFrames; ++frame) {
+                ramp[frame] = start + step * (frame + 1);
+            }
+        }
+        else {
+            for (int frame = 0; frame < numFrames; ++frame) {
+                ramp[frame * stride] = start + step * (frame + 1);
+            }
+        }
+    }
+    
+    /** Writes target + distance * decay^(frame + 1) to every stride-th float,
+        returns the distance left after numFrames
+     
+        Eight interleaved chains, each decaying by decay^8, instead of one
+        chain of dependent multiplies.
+     */
+    float fillExponential(float* ramp, int stride, int numFrames, float target, float distance, float decay)
+    {
+        float powers[8];
+        powers[0] = decay;
+        for (int k = 1; k < 8; ++k) {
+            powers[k] = powers[k - 1] * decay;
+        }
+        
+        int frame = 0;
+        for (; frame <= numFrames - 8; frame += 8) {
+            float* r = ramp + frame * stride;
+            for (int k = 0; k < 8; ++k) {
+                r[k * stride] = target + distance * powers[k];
+            }
+            distance *= powers[7];
+        }
+        for (; frame < numFrames; ++frame) {
+            distance *= decay;
+            ramp[frame * stride] = target + distance;
+        }
+        return distance;
+    }
+}
+
+ParameterSmoother::ParameterSmoother()
+: shape(linear), smoothingSamples(0.), target(0.f), decay(0.f)
+{
+}
+
+void ParameterSmoother::prepare(int numChannels)
+{
+    state.setSize(numStateVariables, numChannels);
+    reset();
+}
+
+void ParameterSmoother::setup(Shape newShape, double newSmoothingSamples)
+{
+    shape = newShape;
+    smoothingSamples = std::max(newSmoothingSamples, 0.);
+    decay = smoothingSamples > 0. ? static_cast<float>(std::exp(-1. / smoothingSamples)) : 0.f;
+    reset();
+}
+
+void ParameterSmoother::setTarget(float newTarget)
+{
+    if (newTarget != target) {
+        target = newTarget;
+        if (smoothingSamples <= 0.) {
+            reset();
+        }
+    }
+}
+
+void ParameterSmoother::reset()
+{
+    for (int channel = 0; channel < state.getNumChannels(); ++channel) {
+        state.getVariable(current)[channel] = target;
+        state.getVariable(rampTarget)[channel] = target;
+        state.getVariable(increment)[channel] = 0.f;
+        state.getVariable(remaining)[channel] = 0.f;
+    }
+}
+
+bool ParameterSmoother::isSettled(int firstChannel, int numLanes) const
+{
+    const float* values = state.getVariable(current) + firstChannel;
+    for (int lane = 0; lane < numLanes; ++lane) {
+        if (values[lane] != target) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float ParameterSmoother::getCurrentValue(int channel) const
+{
+    return state.getVariable(current)[channel];
+}
+
+void ParameterSmoother::process(int firstChannel, int numLanes, float* ramp, int numFrames)
+{
+    float* const values = state.getVariable(current) + firstChannel;
+    float* const targets = state.getVariable(rampTarget) + firstChannel;
+    float* const increments = state.getVariable(increment) + firstChannel;
+    float* const remainders = state.getVariable(remaining) + firstChannel;
+
+    for (int lane = 0; lane < numLanes; ++lane) {
+        float value = values[lane];
+
+        if (targets[lane] != target) {
+            targets[lane] = target;
+            if (shape == linear) {
+                const float length = std::max(static_cast<float>(std::round(smoothingSamples)), 1.f);
+                increments[lane] = (target - value) / length;
+                remainders[lane] = length;
+            }
+        }
+
+        if (shape == linear) {
+            const int rampFrames = std::min(static_cast<int>(remainders[lane]), numFrames);
+            const float step = increments[lane];
+            const float start = value;
+
+            if (ramp != nullptr) {
+                fillLinear(ramp + lane, numLanes, rampFrames, start, step);
+                fillLinear(ramp + rampFrames * numLanes + lane, numLanes, numFrames - rampFrames, target, 0.f);
+            }
+
+            remainders[lane] -= rampFrames;
+            value = remainders[lane] > 0.f ? start + step * rampFrames : target;
+        }
+        else {
+            // value[n] = target + (value[0] - target) * decay^n
+            const float tolerance = exponentialTolerance * std::max(std::fabs(target), 1.f);
+            float distance = value - target;
+
+            if (ramp != nullptr) {
+                distance = fillExponential(ramp + lane, numLanes, numFrames, target, distance, decay);
+            }
+            else {
+                distance *= std::pow(decay, static_cast<float>(numFrames));
+            }
+
+            value = std::fabs(distance) > tolerance ? target + distance : target;
+        }
+
+        values[lane] = value;
+    }
+}
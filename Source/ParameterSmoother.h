@@ -0,0 +1,80 @@
+#ifndef PARAMETERSMOOTHER_H_INCLUDED
+#define PARAMETERSMOOTHER_H_INCLUDED
+
+#include "ChannelState.h"
+
+/**
+    Smooths the changes of a control into per-sample ramps.
+
+    Every channel keeps its own current value and ramp in ChannelState, as
+    the channels of a block are processed one after the other (or in groups
+    of lanes) and each has to see the same ramp. A channel restarts its ramp
+    when it sees a new target at the start of a block.
+
+    The ramps are linear, reaching the target after the smoothing time, or
+    exponential, a one-pole filter with the smoothing time as time constant
+    that snaps to the target once it's within a small tolerance.
+
+    Memory is only allocated by prepare().
+ */
+class ParameterSmoother
+{
+public:
+    enum Shape {
+        linear,
+        exponential
+    };
+
+    ParameterSmoother();
+
+    /// Allocates the state of numChannels channels, all settled on the target
+    void prepare(int numChannels);
+
+    /// Sets the ramp shape and the smoothing time in samples at the rate the
+    /// ramps are made, settles every channel
+    void setup(Shape newShape, double newSmoothingSamples);
+
+    /// Sets the value every channel moves to, with no smoothing time every
+    /// channel jumps to it
+    void setTarget(float newTarget);
+
+    float getTarget() const             { return target; }
+
+    /// Jumps every channel to the target
+    void reset();
+
+    /// Returns true if every lane has reached the target and will stay there
+    bool isSettled(int firstChannel, int numLanes) const;
+
+    /// Returns the current value of a channel
+    float getCurrentValue(int channel) const;
+
+    /** Writes numFrames frames of numLanes interleaved ramps, one lane per
+        channel from firstChannel, and advances the channels
+
+        The ramp may be nullptr to only advance.
+     */
+    void process(int firstChannel, int numLanes, float* ramp, int numFrames);
+
+private:
+    enum StateVariable {
+        // The value at the end of the last block
+        current,
+        // The target the ramp is heading to
+        rampTarget,
+        // The linear increment per sample
+        increment,
+        // The samples left in the linear ramp
+        remaining,
+        numStateVariables
+    };
+    ChannelState<float> state;
+
+    Shape shape;
+    double smoothingSamples;
+    float target;
+    // The one-pole coefficient of the exponential ramp
+    float decay;
+};
+
+#endif  // PARAMETERSMOOTHER_H_INCLUDED
@@ -31,6 +31,16 @@ PluginEditor::PluginEditor (PluginAudioProcessor& p)
     : AudioProcessorEditor (&p), processor (p)
 {
     //[Constructor_pre] You can add your own custom stuff here..
+    timingCountdown = 0;
+
+    addAndMakeVisible (timingLabel = new Label ("timing", String::empty));
+    timingLabel->setFont (Font (Font::getDefaultMonospacedFontName(), 13.0f, Font::plain));
+    timingLabel->setJustificationType (Justification::topLeft);
+    timingLabel->setColour (Label::textColourId, Colours::lightgrey);
+
+    addAndMakeVisible (saveTimingButton = new TextButton ("save timing"));
+    saveTimingButton->setButtonText ("Save timing");
+    saveTimingButton->addListener (this);
     //[/Constructor_pre]
 
 
@@ -48,6 +58,8 @@ PluginEditor::PluginEditor (PluginAudioProcessor& p)
 PluginEditor::~PluginEditor()
 {
     //[Destructor_pre]. You can add your own custom destruction code here..
+    timingLabel = nullptr;
+    saveTimingButton = nullptr;
     //[/Destructor_pre]
 
 
@@ -74,6 +86,8 @@ void PluginEditor::resized()
     //[/UserPreResize]
 
     //[UserResized] Add your own custom resize handling here..
+    timingLabel->setBounds (16, 16, getWidth() - 32, 80);
+    saveTimingButton->setBounds (16, 104, 120, 24);
     //[/UserResized]
 }
 
@@ -89,6 +103,45 @@ void PluginEditor::resized()
 */
 void PluginEditor::timerCallback() {
     // E.g. mySlider->setValue(processor.myParam->getActualValue(), dontSendNotification);
+
+    // About twice a second, sorting the history isn't free
+    if (--timingCountdown <= 0) {
+        timingCountdown = 16;
+        updateTiming();
+    }
+}
+
+/**
+    Shows the load of the latest blocks, the time processBlock took as a
+    percentage of their real-time budget.
+*/
+void PluginEditor::updateTiming() {
+    const BlockTiming::Statistics statistics = processor.getBlockTimingStatistics();
+
+    String text = "Block load over the last " + String (statistics.numBlocks) + " blocks\n"
+        + "median " + String (100. * statistics.median, 1) + "%, "
+        + "90% " + String (100. * statistics.percentile90, 1) + "%, "
+        + "99% " + String (100. * statistics.percentile99, 1) + "%, "
+        + "max " + String (100. * statistics.maximum, 1) + "%\n"
+        + "Deadline misses: " + String ((int64) statistics.deadlineMisses) + " of " + String ((int64) statistics.totalBlocks)
+        + " blocks, worst " + String (100. * statistics.worstLoad, 1) + "%";
+
+    if (statistics.droppedBlocks > 0) {
+        text += ", " + String ((int64) statistics.droppedBlocks) + " not recorded";
+    }
+    if (lastTimingReport.isNotEmpty()) {
+        text += "\n" + lastTimingReport;
+    }
+    timingLabel->setText (text, dontSendNotification);
+}
+
+void PluginEditor::buttonClicked (Button* button) {
+    if (button == saveTimingButton) {
+        const File file = processor.saveBlockTimingReport();
+        lastTimingReport = file.existsAsFile() ? "Saved to " + file.getFullPathName()
+                                               : String ("Couldn't save the timing");
+        updateTiming();
+    }
 }
 
 //[/MiscUserCode]
@@ -104,7 +157,7 @@ void PluginEditor::timerCallback() {
 BEGIN_JUCER_METADATA
 
 <JUCER_COMPONENT documentType="Component" className="PluginEditor" componentName=""
-                 parentClasses="public AudioProcessorEditor, public Timer" constructorParams="PluginAudioProcessor&amp; p"
+                 parentClasses="public AudioProcessorEditor, public Timer, public ButtonListener" constructorParams="PluginAudioProcessor&amp; p"
                  variableInitialisers="AudioProcessorEditor (&amp;p), processor (p)"
                  snapPixels="8" snapActive="1" snapShown="1" overlayOpacity="0.330"
                  fixedSize="0" initialWidth="600" initialHeight="400">
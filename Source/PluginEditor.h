@@ -36,7 +36,8 @@
                                                                     //[/Comments]
 */
 class PluginEditor  : public AudioProcessorEditor,
-                      public Timer
+                      public Timer,
+                      public ButtonListener
 {
 public:
     //==============================================================================
@@ -46,6 +47,7 @@ public:
     //==============================================================================
     //[UserMethods]     -- You can add your own custom methods in this section.
     void timerCallback();
+    void buttonClicked (Button* button);
     //[/UserMethods]
 
     void paint (Graphics& g);
@@ -60,6 +62,14 @@ private:
     // processor object that created it.
     PluginAudioProcessor& processor;
 
+    // The processing time of the blocks, updated every few timer callbacks
+    ScopedPointer<Label> timingLabel;
+    ScopedPointer<TextButton> saveTimingButton;
+    int timingCountdown;
+    String lastTimingReport;
+
+    void updateTiming();
+
     //[/UserVariables]
 
     //==============================================================================
@@ -1,40 +1,101 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "ScopedFlushDenormals.h"
 
 //==============================================================================
 PluginAudioProcessor::PluginAudioProcessor()
+: controlsVersion(0),
+  controlsWriters(0),
+  automation(smoothedAutomation),
+  currentAutomation(smoothedAutomation),
+  oversamplingStages(0),
+  oversamplingQuality(Oversampler::medium),
+  antialiasingOrder(Distortion::noAntialiasing),
+  curveAccuracy(Distortion::referenceAccuracy),
+  pendingLatency(0),
+  blockTimingCollector(blockTiming)
 {
     processor = new Distortion();
+    controlValues[modeControl].store(static_cast<float>(processor->controls.mode));
+    controlValues[driveControl].store(processor->controls.drive);
+    controlValues[thresholdControl].store(processor->controls.threshold);
+    controlValues[mixControl].store(processor->controls.mix);
+    controlValues[shapeControl].store(processor->controls.shape);
 
     // Create and add parameters
     addParameter(mode
                  = new PluginParameter(Identifier("mode"),
-                                       0.f, 0.f, 8.f, "Mode", String::empty, 0,
+                                       0.f, 0.f, static_cast<float>(Distortion::numModes - 1),
+                                       "Mode", String::empty, 0,
                                        [this] (float actualValue) {
-                                           processor->controls.mode
-                                           = static_cast<int>(floorf(actualValue));
+                                           setControl(modeControl, floorf(actualValue));
                                        }));
 
     addParameter(drive
                  = new PluginParameter(Identifier("drive"),
                                        1.f, 1.f, 25.f, "Drive", String::empty, 2,
                                        [this] (float actualValue) {
-                                           processor->controls.drive = actualValue;
+                                           setControl(driveControl, actualValue);
                                        }));
     
     addParameter(threshold
                  = new PluginParameter(Identifier("threshold"),
                                        1.f, 0.01f, 1.f, "Threshold", String::empty, 2,
                                        [this] (float actualValue) {
-                                           processor->controls.threshold = actualValue;
+                                           setControl(thresholdControl, actualValue);
                                        }));
     
     addParameter(mix
                  = new PluginParameter(Identifier("mix"),
                                        1.f, "Mix", String::empty, 2,
                                        [this] (float actualValue) {
-                                           processor->controls.mix = actualValue;
+                                           setControl(mixControl, actualValue);
                                        }));
+    
+    // The alpha of the wave shaper modes, after mix so the parameters before
+    // it keep their indices
+    addParameter(shape
+                 = new PluginParameter(Identifier("shape"),
+                                       0.5f, "Shape", String::empty, 2,
+                                       [this] (float actualValue) {
+                                           setControl(shapeControl, actualValue);
+                                       }));
+    
+    // 2^stages times oversampling, 0 is off
+    addParameter(oversampling
+                 = new PluginParameter(Identifier("oversampling"),
+                                       0.f, 0.f, static_cast<float>(Oversampler::maxStages),
+                                       "Oversampling", String::empty, 0,
+                                       [this] (float actualValue) {
+                                           oversamplingStages.set(roundToInt(actualValue));
+                                       }));
+    
+    addParameter(quality
+                 = new PluginParameter(Identifier("quality"),
+                                       1.f, 0.f, 2.f, "Quality", String::empty, 0,
+                                       [this] (float actualValue) {
+                                           oversamplingQuality.set(roundToInt(actualValue));
+                                       }));
+    
+    // Antiderivative anti-aliasing order, 0 is off
+    addParameter(antialiasing
+                 = new PluginParameter(Identifier("antialiasing"),
+                                       0.f, 0.f, 2.f, "Anti-aliasing", String::empty, 0,
+                                       [this] (float actualValue) {
+                                           antialiasingOrder.set(roundToInt(actualValue));
+                                       }));
+    
+    // 0 computes the reference curves, 1 their faster approximations, see
+    // Distortion::Accuracy
+    addParameter(accuracy
+                 = new PluginParameter(Identifier("accuracy"),
+                                       0.f, 0.f, 1.f, "Fast curves", String::empty, 0,
+                                       [this] (float actualValue) {
+                                           curveAccuracy.set(roundToInt(actualValue));
+                                       }));
+    
+    // The queue holds a few thousand blocks, collect well before it fills
+    blockTimingCollector.startTimer(100);
 }
 
 PluginAudioProcessor::~PluginAudioProcessor()
@@ -87,12 +148,14 @@ bool PluginAudioProcessor::producesMidi() const
 
 bool PluginAudioProcessor::silenceInProducesSilenceOut() const
 {
-    return false;
+    // Every mode maps 0 to 0, after the tail
+    return true;
 }
 
 double PluginAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    const double sampleRate = getSampleRate();
+    return sampleRate > 0.0 ? processor->getTailLengthInSamples() / sampleRate : 0.0;
 }
 
 int PluginAudioProcessor::getNumPrograms()
@@ -124,6 +187,13 @@ void PluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    processor->prepare(sampleRate, samplesPerBlock, getNumInputChannels());
+    updateAntialiasing();
+    handleUpdateNowIfNeeded();
+    blockTiming.prepare(sampleRate);
+    
+    maximumBlockSize = samplesPerBlock;
+    interleavedFrames.allocate(static_cast<size_t>(samplesPerBlock * Distortion::maxLanes), true);
 }
 
 void PluginAudioProcessor::releaseResources()
@@ -134,6 +204,31 @@ void PluginAudioProcessor::releaseResources()
 
 void PluginAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
+    processBuffer(buffer);
+}
+
+#if DISTORTION_DOUBLE_PRECISION
+void PluginAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+    processBuffer(buffer);
+}
+
+bool PluginAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+#endif
+
+/// Processes a block of floats or doubles
+template <typename Buffer>
+void PluginAudioProcessor::processBuffer (Buffer& buffer)
+{
+    // Against the time the host has for the block, until the end of it
+    const BlockTiming::ScopedBlock timing(blockTiming, buffer.getNumSamples());
+    
+    // Decaying tails mustn't go denormal anywhere in the block
+    const ScopedFlushDenormals flushDenormals;
+    
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
     // guaranteed to be empty - they may contain garbage).
@@ -143,24 +238,223 @@ void PluginAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer&
     for (int i = getNumInputChannels(); i < getNumOutputChannels(); ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-//    std::cout << processor->controls.mode << std::endl;
-//    std::cout << processor->controls.drive << std::endl;
-//    std::cout << processor->controls.mix << std::endl;
-//    std::cout << std::endl;
+    updateAutomation();
+    updateAntialiasing();
+    
+    // One set of controls for the whole block
+    readControls(processor->controls);
+    processSegment(buffer, 0, buffer.getNumSamples());
+}
+
+/**
+    Processes part of a block with the current controls.
+
+    While oversampling the channels are interleaved, the filters run on
+    several channels at once. Otherwise they're processed in place one at a
+    time, the kernels gain nothing from the copies.
+*/
+void PluginAudioProcessor::processSegment (AudioSampleBuffer& buffer, int start, int numSamples)
+{
+    if (processor->isInterleavingWorthwhile() && getNumInputChannels() > 1 && maximumBlockSize > 0) {
+        processInterleaved(buffer, start, numSamples);
+        return;
+    }
     
     for (int channel = 0; channel < getNumInputChannels(); ++channel) {
-        float* channelData = buffer.getWritePointer (channel);
+        float* channelData = buffer.getWritePointer (channel, start);
+        processor->processBlock(channel, channelData, numSamples);
+    }
+}
+
+#if DISTORTION_DOUBLE_PRECISION
+/**
+    Processes part of a double precision block with the current controls, one
+    channel at a time. The channels are never interleaved, only the stages
+    that need floats convert to them, see Distortion::processBlock().
+*/
+void PluginAudioProcessor::processSegment (AudioBuffer<double>& buffer, int start, int numSamples)
+{
+    for (int channel = 0; channel < getNumInputChannels(); ++channel) {
+        double* channelData = buffer.getWritePointer (channel, start);
+        processor->processBlock(channel, channelData, numSamples);
+    }
+}
+#endif
+
+/**
+    Processes groups of channels as the lanes of one interleaved block.
 
-        for (int i = 0; i < buffer.getNumSamples(); ++i) {
-            channelData[i] = processor->processSample(channelData[i]);
+    The channels are interleaved into the scratch frames, processed together
+    and deinterleaved back into the buffer. Blocks longer than the size given
+    to prepareToPlay are split to fit the scratch space.
+*/
+void PluginAudioProcessor::processInterleaved (AudioSampleBuffer& buffer, int offset, int numSamples)
+{
+    const int numChannels = getNumInputChannels();
+    const int numLanes = processor->getPreferredNumLanes();
+    float** const channelData = buffer.getArrayOfWritePointers();
+    const int end = offset + numSamples;
+    
+    for (int start = offset; start < end; start += maximumBlockSize) {
+        const int numFrames = jmin (maximumBlockSize, end - start);
+        
+        for (int firstChannel = 0; firstChannel < numChannels; firstChannel += numLanes) {
+            const int groupSize = jmin (numLanes, numChannels - firstChannel);
+            
+            for (int lane = 0; lane < groupSize; ++lane) {
+                const float* source = channelData[firstChannel + lane] + start;
+                for (int i = 0; i < numFrames; ++i) {
+                    interleavedFrames[i * groupSize + lane] = source[i];
+                }
+            }
+            
+            processor->processInterleaved(firstChannel, groupSize, interleavedFrames, numFrames);
+            
+            for (int lane = 0; lane < groupSize; ++lane) {
+                float* destination = channelData[firstChannel + lane] + start;
+                for (int i = 0; i < numFrames; ++i) {
+                    destination[i] = interleavedFrames[i * groupSize + lane];
+                }
+            }
+        }
+    }
+}
+
+/**
+    Applies the oversampling, anti-aliasing and accuracy parameters. The
+    Distortion only redesigns its filters when they change. A new latency is
+    reported to the host from the message thread, see handleAsyncUpdate().
+*/
+void PluginAudioProcessor::updateAntialiasing()
+{
+    processor->setOversampling(oversamplingStages.get(),
+                               static_cast<Oversampler::Quality>(oversamplingQuality.get()));
+    processor->setAntialiasing(static_cast<Distortion::Antialiasing>(antialiasingOrder.get()));
+    processor->setAccuracy(static_cast<Distortion::Accuracy>(curveAccuracy.get()));
+    
+    const int latency = roundToInt(processor->getLatencyInSamples());
+    if (latency != pendingLatency.get()) {
+        pendingLatency.set(latency);
+        triggerAsyncUpdate();
+    }
+}
+
+void PluginAudioProcessor::handleAsyncUpdate()
+{
+    setLatencySamples(pendingLatency.get());
+}
+
+/**
+    Switches between smoothed and immediate automation between blocks.
+    Immediate automation turns the smoothing off, so every block runs the
+    constant-control kernels with the latest controls.
+*/
+void PluginAudioProcessor::updateAutomation()
+{
+    const Automation newAutomation = static_cast<Automation>(automation.get());
+    if (newAutomation == currentAutomation) {
+        return;
+    }
+    currentAutomation = newAutomation;
+    
+    if (currentAutomation == immediateAutomation) {
+        processor->setSmoothing(ParameterSmoother::linear, 0.);
+    }
+    else {
+        processor->setSmoothing(ParameterSmoother::linear, Distortion::defaultSmoothingTime);
+    }
+}
+
+/**
+    Changes one control, from any thread. The store doesn't take a lock, so
+    the audio thread never waits on a parameter change, even one made on
+    another thread at the same time.
+*/
+void PluginAudioProcessor::setControl (Control control, float value)
+{
+    controlsWriters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    controlValues[control].store(value, std::memory_order_relaxed);
+    controlsVersion.fetch_add(1, std::memory_order_release);
+    controlsWriters.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+    Copies the latest value of every control into controls, as they were
+    between two setControl() calls. If a store overlaps every attempt, this
+    returns false and leaves controls as they were, the audio thread then
+    keeps the previous block's controls rather than wait for the writers.
+*/
+bool PluginAudioProcessor::readControls (Distortion::Controls& controls) const
+{
+    // A store only takes a few instructions, so overlapping more than a
+    // couple of attempts means the writers keep coming
+    const int maximumAttempts = 4;
+    
+    for (int attempt = 0; attempt < maximumAttempts; ++attempt) {
+        const unsigned int version = controlsVersion.load(std::memory_order_acquire);
+        if (controlsWriters.load(std::memory_order_acquire) != 0) {
+            continue;
+        }
+        
+        float values[numControls];
+        for (int control = 0; control < numControls; ++control) {
+            values[control] = controlValues[control].load(std::memory_order_relaxed);
+        }
+        
+        // A store seen above was counted in controlsWriters before it was
+        // made, and bumps the version before it's uncounted
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (controlsWriters.load(std::memory_order_acquire) == 0
+            && controlsVersion.load(std::memory_order_relaxed) == version) {
+            for (int control = 0; control < numControls; ++control) {
+                applyControl(controls, static_cast<Control>(control), values[control]);
+            }
+            return true;
         }
     }
+    return false;
+}
+
+void PluginAudioProcessor::applyControl (Distortion::Controls& controls, Control control, float value)
+{
+    switch (control) {
+        case modeControl:       controls.mode = static_cast<int>(value); break;
+        case driveControl:      controls.drive = value; break;
+        case thresholdControl:  controls.threshold = value; break;
+        case mixControl:        controls.mix = value; break;
+        case shapeControl:      controls.shape = value; break;
+        default:                break;
+    }
+}
+
+void PluginAudioProcessor::setAutomation (Automation newAutomation)
+{
+    automation.set(newAutomation);
+}
+
+BlockTiming::Statistics PluginAudioProcessor::getBlockTimingStatistics()
+{
+    return blockTiming.getStatistics();
+}
+
+File PluginAudioProcessor::saveBlockTimingReport()
+{
+    blockTiming.collect();
+    
+    const File file = File::getSpecialLocation (File::userDocumentsDirectory)
+        .getNonexistentChildFile ("juce-distortion timing " + Time::getCurrentTime().formatted ("%Y-%m-%d %H-%M-%S"),
+                                  ".csv");
+    if (! file.replaceWithText (String (blockTiming.createReport()))) {
+        return File();
+    }
+    return file;
 }
 
 //==============================================================================
 bool PluginAudioProcessor::hasEditor() const
 {
-    return false; // (change this to false if you choose to not supply an editor)
+    return true; // (change this to false if you choose to not supply an editor)
 }
 
 AudioProcessorEditor* PluginAudioProcessor::createEditor()
@@ -3,8 +3,11 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginParameter.h"
+#include "BlockTiming.h"
 #include "Distortion.h"
 
+#include <atomic>
+
 /** Helper Macros
     
     All audio samples are represented in unit voltage (uV) as a float in the
@@ -20,10 +23,18 @@
 #define dB(x) 20.0 * ((x) > 0.00001 ? log10(x) : -5.0)  // uV -> dB
 #define uV(x) pow(10.0, (x) / 20.0)                     // dB -> uV
 
+// Hosts can hand double precision buffers to plugins from JUCE 4.1
+#if JUCE_MAJOR_VERSION > 4 || (JUCE_MAJOR_VERSION == 4 && JUCE_MINOR_VERSION >= 1)
+ #define DISTORTION_DOUBLE_PRECISION 1
+#else
+ #define DISTORTION_DOUBLE_PRECISION 0
+#endif
+
 //==============================================================================
 /**
 */
-class PluginAudioProcessor  : public AudioProcessor
+class PluginAudioProcessor  : public AudioProcessor,
+                              private AsyncUpdater
 {
 public:
     //==============================================================================
@@ -35,6 +46,10 @@ public:
     void releaseResources() override;
 
     void processBlock (AudioSampleBuffer&, MidiBuffer&) override;
+   #if DISTORTION_DOUBLE_PRECISION
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
+   #endif
 
     //==============================================================================
     AudioProcessorEditor* createEditor() override;
@@ -63,15 +78,109 @@ public:
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    /// How the changes of the controls take effect
+    enum Automation {
+        /// From the start of the next block, drive and mix are smoothed
+        smoothedAutomation,
+        /// At the start of the next block without smoothing, which is at the
+        /// sample they happened in hosts that split their blocks there
+        immediateAutomation
+    };
+    
+    /// Sets when control changes take effect, from the next block
+    void setAutomation(Automation newAutomation);
+    
+    /// Returns the time processBlock takes against the real-time budget of
+    /// the blocks, see BlockTiming
+    BlockTiming::Statistics getBlockTimingStatistics();
+    
+    /// Writes the timing of the latest blocks to a new file in the user's
+    /// documents, returns it or a nonexistent file if it couldn't be written
+    File saveBlockTimingReport();
+    
     // Parameters
     AudioProcessorParameter* mode;
     AudioProcessorParameter* drive;
     AudioProcessorParameter* threshold;
     AudioProcessorParameter* mix;
+    AudioProcessorParameter* shape;
+    AudioProcessorParameter* oversampling;
+    AudioProcessorParameter* quality;
+    AudioProcessorParameter* antialiasing;
+    AudioProcessorParameter* accuracy;
     
 private:
     ScopedPointer<Distortion> processor;
     
+    // The fields of Distortion::Controls the parameters set
+    enum Control {
+        modeControl,
+        driveControl,
+        thresholdControl,
+        mixControl,
+        shapeControl,
+        numControls
+    };
+    
+    // The parameters store their control from any thread, each in its own
+    // atomic so no writer waits on another. The audio thread reads them all
+    // once per block, the mode as a whole number.
+    std::atomic<float> controlValues[numControls];
+    // Like a seqlock with several writers: each store is counted while it's
+    // in progress and bumps the version once done, so a reader can tell
+    // whether its copy of the values was taken without a store in between
+    std::atomic<unsigned int> controlsVersion;
+    std::atomic<int> controlsWriters;
+    
+    void setControl(Control control, float value);
+    bool readControls(Distortion::Controls& controls) const;
+    static void applyControl(Distortion::Controls& controls, Control control, float value);
+    
+    Atomic<int> automation;
+    Automation currentAutomation;
+    
+    void updateAutomation();
+    template <typename Buffer>
+    void processBuffer(Buffer& buffer);
+    void processSegment(AudioSampleBuffer& buffer, int start, int numSamples);
+   #if DISTORTION_DOUBLE_PRECISION
+    void processSegment(AudioBuffer<double>& buffer, int start, int numSamples);
+   #endif
+    
+    // Set by the parameters, applied between blocks
+    Atomic<int> oversamplingStages;
+    Atomic<int> oversamplingQuality;
+    Atomic<int> antialiasingOrder;
+    Atomic<int> curveAccuracy;
+    
+    void updateAntialiasing();
+    
+    // The latency the host is told about on the message thread, hosts
+    // don't expect setLatencySamples() on the audio thread
+    Atomic<int> pendingLatency;
+    void handleAsyncUpdate() override;
+    
+    // Scratch space for interleaved channels, sized in prepareToPlay
+    HeapBlock<float> interleavedFrames;
+    int maximumBlockSize = 0;
+    
+    void processInterleaved(AudioSampleBuffer& buffer, int start, int numSamples);
+    
+    // Every block is timed on the audio thread, the records are collected
+    // on the message thread whether or not the editor is open
+    BlockTiming blockTiming;
+    
+    class BlockTimingCollector : public Timer
+    {
+    public:
+        explicit BlockTimingCollector(BlockTiming& newTiming) : timing(newTiming) {}
+        void timerCallback() override       { timing.collect(); }
+        
+    private:
+        BlockTiming& timing;
+    };
+    BlockTimingCollector blockTimingCollector;
+    
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginAudioProcessor)
 };
@@ -0,0 +1,70 @@
+#ifndef SCOPEDFLUSHDENORMALS_H_INCLUDED
+#define SCOPEDFLUSHDENORMALS_H_INCLUDED
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+ #include <xmmintrin.h>
+ #define DISTORTION_DENORMALS_MXCSR 1
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+ #include <cstdint>
+ #define DISTORTION_DENORMALS_FPCR 1
+#endif
+
+/**
+    Flushes denormal floats to zero while in scope.
+
+    Decaying signals and filter states can reach the denormal range, where
+    every operation on them is many times slower on x86. On x86 this sets
+    flush-to-zero (denormal results become 0) and denormals-are-zero
+    (denormal inputs are read as 0) in the MXCSR register, on 64-bit ARM the
+    flush-to-zero bit of the FPCR register, which covers both. The previous
+    mode is restored on destruction, so the host's own code is unaffected.
+
+    The mode is per thread and costs a register write each way, so scope it
+    around whole blocks rather than per sample. Elsewhere this does nothing.
+ */
+class ScopedFlushDenormals
+{
+public:
+   #if DISTORTION_DENORMALS_MXCSR
+    ScopedFlushDenormals()
+    : previousMode(_mm_getcsr())
+    {
+        // Flush-to-zero and denormals-are-zero
+        _mm_setcsr(previousMode | 0x8040);
+    }
+
+    ~ScopedFlushDenormals()
+    {
+        _mm_setcsr(previousMode);
+    }
+
+   #elif DISTORTION_DENORMALS_FPCR
+    ScopedFlushDenormals()
+    {
+        asm volatile ("mrs %0, fpcr" : "=r" (previousMode));
+        // Flush-to-zero
+        const uint64_t mode = previousMode | (static_cast<uint64_t>(1) << 24);
+        asm volatile ("msr fpcr, %0" : : "r" (mode));
+    }
+
+    ~ScopedFlushDenormals()
+    {
+        asm volatile ("msr fpcr, %0" : : "r" (previousMode));
+    }
+
+   #else
+    ScopedFlushDenormals() {}
+   #endif
+
+    ScopedFlushDenormals(const ScopedFlushDenormals&) = delete;
+    ScopedFlushDenormals& operator=(const ScopedFlushDenormals&) = delete;
+
+private:
+   #if DISTORTION_DENORMALS_MXCSR
+    unsigned int previousMode;
+   #elif DISTORTION_DENORMALS_FPCR
+    uint64_t previousMode;
+   #endif
+};
+
+#endif  // SCOPEDFLUSHDENORMALS_H_INCLUDED
@@ -0,0 +1,915 @@
+#ifndef SIMDVECTOR_H_INCLUDED
+#define SIMDVECTOR_H_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**
+    Thin wrappers around the x86 vector registers used by the DSP kernels.
+
+    Each wrapper holds one register of floats and overloads the arithmetic and
+    comparison operators, so a kernel written once as a template runs 4, 8 or 16
+    samples per iteration depending on the type it is instantiated with. The
+    same free functions (vmin, vselect, vfloor, ...) are defined for plain
+    floats, which lets the polynomial nonlinearities share one definition
+    between the vector loop and the scalar tail.
+
+    Each float wrapper has a double counterpart with half the lanes, for the
+    double precision kernels. vexp and vatan pick their polynomials by the
+    lane type, so the double vectors get vexpDouble and vatanDouble and agree
+    with the scalar double kernels. The fast approximations and vsin are
+    shared by floats and doubles, and table lookups gather the float
+    coefficients and widen them.
+
+    vrsqrt is the hardware estimate of 1 / sqrt where there is one, good to 12
+    bits on SSE and AVX and 14 on AVX-512, so it needs a Newton step for most
+    uses. The scalar and other double versions are exact.
+
+    Which wrappers exist depends on the instruction sets the translation unit
+    is compiled for. A DISTORTION_SIMD_* macro can be defined before including
+    this file to enable an instruction set the compiler flags don't. Like the
+    kernels, everything is in an anonymous namespace so the per instruction set
+    builds of this header stay separate.
+ */
+
+#if ! defined(DISTORTION_SIMD_SSE2) && (defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+ #define DISTORTION_SIMD_SSE2 1
+#endif
+
+#if ! defined(DISTORTION_SIMD_SSE41) && defined(__SSE4_1__)
+ #define DISTORTION_SIMD_SSE41 1
+#endif
+
+#if ! defined(DISTORTION_SIMD_AVX2) && defined(__AVX2__)
+ #define DISTORTION_SIMD_AVX2 1
+#endif
+
+#if ! defined(DISTORTION_SIMD_FMA) && defined(__FMA__)
+ #define DISTORTION_SIMD_FMA 1
+#endif
+
+#if ! defined(DISTORTION_SIMD_AVX512) && defined(__AVX512F__)
+ #define DISTORTION_SIMD_AVX512 1
+#endif
+
+#if DISTORTION_SIMD_SSE2
+ #include <immintrin.h>
+#endif
+
+namespace
+{
+
+//==============================================================================
+// Scalar versions of the vector operations
+
+inline float vmin(float a, float b)                 { return a < b ? a : b; }
+inline float vmax(float a, float b)                 { return a > b ? a : b; }
+inline float vabs(float a)                          { return std::fabs(a); }
+inline float vsqrt(float a)                         { return std::sqrt(a); }
+inline float vrsqrt(float a)                        { return 1.f / std::sqrt(a); }
+inline float vfloor(float a)                        { return std::floor(a); }
+inline float vtrunc(float a)                        { return std::trunc(a); }
+inline float vselect(bool mask, float a, float b)   { return mask ? a : b; }
+inline float vmuladd(float a, float b, float c)     { return a * b + c; }
+
+/// Returns a * 2^n, n must be an integer in [-126, 127]. Builds 2^n from its
+/// exponent bits like the vector versions, std::ldexp is a library call.
+inline float vldexp(float a, float n)
+{
+    const uint32_t bits = static_cast<uint32_t>(static_cast<int>(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return a * scale;
+}
+
+inline void vgather4(const float* p, float index, float& a, float& b, float& c, float& d)
+{
+    p += 4 * static_cast<int>(index);
+    a = p[0];
+    b = p[1];
+    c = p[2];
+    d = p[3];
+}
+
+inline double vmin(double a, double b)              { return a < b ? a : b; }
+inline double vmax(double a, double b)              { return a > b ? a : b; }
+inline double vabs(double a)                        { return std::fabs(a); }
+inline double vsqrt(double a)                       { return std::sqrt(a); }
+inline double vrsqrt(double a)                      { return 1. / std::sqrt(a); }
+inline double vfloor(double a)                      { return std::floor(a); }
+inline double vtrunc(double a)                      { return std::trunc(a); }
+inline double vselect(bool mask, double a, double b) { return mask ? a : b; }
+inline bool vany(bool mask)                         { return mask; }
+inline double vmuladd(double a, double b, double c) { return a * b + c; }
+
+/// Returns a * 2^n, n must be an integer in [-1022, 1023]
+inline double vldexp(double a, double n)
+{
+    const uint64_t bits = static_cast<uint64_t>(static_cast<int>(n) + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return a * scale;
+}
+
+/// Returns the mantissa of a in [0.5, 1) and sets exponent to its power of
+/// two, a must be positive and normal
+inline double vfrexp(double a, double& exponent)
+{
+    int e;
+    const double mantissa = std::frexp(a, &e);
+    exponent = e;
+    return mantissa;
+}
+
+inline void vgather4(const float* p, double index, double& a, double& b, double& c, double& d)
+{
+    p += 4 * static_cast<int>(index);
+    a = p[0];
+    b = p[1];
+    c = p[2];
+    d = p[3];
+}
+
+#if DISTORTION_SIMD_SSE2
+//==============================================================================
+/// Four floats in an SSE register
+struct SseFloat
+{
+    typedef SseFloat Mask;
+    typedef float Sample;
+    static const int size = 4;
+
+    __m128 v;
+
+    SseFloat() {}
+    SseFloat(__m128 r) : v(r) {}
+    explicit SseFloat(float f) : v(_mm_set1_ps(f)) {}
+
+    static SseFloat load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const           { _mm_storeu_ps(p, v); }
+};
+
+inline SseFloat operator+(SseFloat a, SseFloat b)   { return _mm_add_ps(a.v, b.v); }
+inline SseFloat operator-(SseFloat a, SseFloat b)   { return _mm_sub_ps(a.v, b.v); }
+inline SseFloat operator*(SseFloat a, SseFloat b)   { return _mm_mul_ps(a.v, b.v); }
+inline SseFloat operator/(SseFloat a, SseFloat b)   { return _mm_div_ps(a.v, b.v); }
+inline SseFloat operator-(SseFloat a)               { return _mm_xor_ps(a.v, _mm_set1_ps(-0.f)); }
+inline SseFloat operator<(SseFloat a, SseFloat b)   { return _mm_cmplt_ps(a.v, b.v); }
+inline SseFloat operator>(SseFloat a, SseFloat b)   { return _mm_cmpgt_ps(a.v, b.v); }
+inline SseFloat operator<=(SseFloat a, SseFloat b)  { return _mm_cmple_ps(a.v, b.v); }
+inline SseFloat operator>=(SseFloat a, SseFloat b)  { return _mm_cmpge_ps(a.v, b.v); }
+inline SseFloat operator&(SseFloat a, SseFloat b)   { return _mm_and_ps(a.v, b.v); }
+inline SseFloat operator|(SseFloat a, SseFloat b)   { return _mm_or_ps(a.v, b.v); }
+
+inline SseFloat vmin(SseFloat a, SseFloat b)        { return _mm_min_ps(a.v, b.v); }
+inline SseFloat vmax(SseFloat a, SseFloat b)        { return _mm_max_ps(a.v, b.v); }
+inline SseFloat vabs(SseFloat a)                    { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline SseFloat vsqrt(SseFloat a)                   { return _mm_sqrt_ps(a.v); }
+inline SseFloat vrsqrt(SseFloat a)                  { return _mm_rsqrt_ps(a.v); }
+
+inline SseFloat vselect(SseFloat mask, SseFloat a, SseFloat b)
+{
+   #if DISTORTION_SIMD_SSE41
+    return _mm_blendv_ps(b.v, a.v, mask.v);
+   #else
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+   #endif
+}
+
+inline SseFloat vmuladd(SseFloat a, SseFloat b, SseFloat c)
+{
+   #if DISTORTION_SIMD_FMA
+    return _mm_fmadd_ps(a.v, b.v, c.v);
+   #else
+    return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v);
+   #endif
+}
+
+inline SseFloat vtrunc(SseFloat a)
+{
+   #if DISTORTION_SIMD_SSE41
+    return _mm_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+   #else
+    // Values beyond 2^23 are already integers and would overflow the conversion
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return vselect(vabs(a) < SseFloat(8388608.f), truncated, a);
+   #endif
+}
+
+inline SseFloat vfloor(SseFloat a)
+{
+   #if DISTORTION_SIMD_SSE41
+    return _mm_floor_ps(a.v);
+   #else
+    const SseFloat truncated = vtrunc(a);
+    return truncated - (SseFloat(1.f) & (truncated > a));
+   #endif
+}
+
+/// Returns a * 2^n, n must be an integer in [-126, 127]
+inline SseFloat vldexp(SseFloat a, SseFloat n)
+{
+    const __m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n.v),
+                                                          _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(a.v, _mm_castsi128_ps(exponent));
+}
+
+/// Loads the four floats at p + 4 * index into a, b, c and d for each lane,
+/// index must hold nonnegative integers. There's no gather before AVX2, so
+/// each lane's floats are loaded at once and transposed.
+inline void vgather4(const float* p, SseFloat index, SseFloat& a, SseFloat& b, SseFloat& c, SseFloat& d)
+{
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_slli_epi32(_mm_cvttps_epi32(index.v), 2));
+
+    __m128 r0 = _mm_loadu_ps(p + i[0]), r1 = _mm_loadu_ps(p + i[1]);
+    __m128 r2 = _mm_loadu_ps(p + i[2]), r3 = _mm_loadu_ps(p + i[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    a = r0;
+    b = r1;
+    c = r2;
+    d = r3;
+}
+
+//==============================================================================
+/// Two doubles in an SSE register
+struct SseDouble
+{
+    typedef SseDouble Mask;
+    typedef double Sample;
+    static const int size = 2;
+
+    __m128d v;
+
+    SseDouble() {}
+    SseDouble(__m128d r) : v(r) {}
+    explicit SseDouble(double d) : v(_mm_set1_pd(d)) {}
+
+    static SseDouble load(const double* p) { return _mm_loadu_pd(p); }
+    void store(double* p) const            { _mm_storeu_pd(p, v); }
+};
+
+inline SseDouble operator+(SseDouble a, SseDouble b)    { return _mm_add_pd(a.v, b.v); }
+inline SseDouble operator-(SseDouble a, SseDouble b)    { return _mm_sub_pd(a.v, b.v); }
+inline SseDouble operator*(SseDouble a, SseDouble b)    { return _mm_mul_pd(a.v, b.v); }
+inline SseDouble operator/(SseDouble a, SseDouble b)    { return _mm_div_pd(a.v, b.v); }
+inline SseDouble operator-(SseDouble a)                 { return _mm_xor_pd(a.v, _mm_set1_pd(-0.)); }
+inline SseDouble operator<(SseDouble a, SseDouble b)    { return _mm_cmplt_pd(a.v, b.v); }
+inline SseDouble operator>(SseDouble a, SseDouble b)    { return _mm_cmpgt_pd(a.v, b.v); }
+inline SseDouble operator<=(SseDouble a, SseDouble b)   { return _mm_cmple_pd(a.v, b.v); }
+inline SseDouble operator>=(SseDouble a, SseDouble b)   { return _mm_cmpge_pd(a.v, b.v); }
+inline SseDouble operator&(SseDouble a, SseDouble b)    { return _mm_and_pd(a.v, b.v); }
+inline SseDouble operator|(SseDouble a, SseDouble b)    { return _mm_or_pd(a.v, b.v); }
+
+inline SseDouble vmin(SseDouble a, SseDouble b)         { return _mm_min_pd(a.v, b.v); }
+inline SseDouble vmax(SseDouble a, SseDouble b)         { return _mm_max_pd(a.v, b.v); }
+inline SseDouble vabs(SseDouble a)                      { return _mm_andnot_pd(_mm_set1_pd(-0.), a.v); }
+inline SseDouble vsqrt(SseDouble a)                     { return _mm_sqrt_pd(a.v); }
+inline SseDouble vrsqrt(SseDouble a)                    { return _mm_div_pd(_mm_set1_pd(1.), _mm_sqrt_pd(a.v)); }
+
+inline SseDouble vselect(SseDouble mask, SseDouble a, SseDouble b)
+{
+   #if DISTORTION_SIMD_SSE41
+    return _mm_blendv_pd(b.v, a.v, mask.v);
+   #else
+    return _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v));
+   #endif
+}
+
+/// Returns true if any lane of the mask is set
+inline bool vany(SseDouble mask)                        { return _mm_movemask_pd(mask.v) != 0; }
+
+inline SseDouble vmuladd(SseDouble a, SseDouble b, SseDouble c)
+{
+   #if DISTORTION_SIMD_FMA
+    return _mm_fmadd_pd(a.v, b.v, c.v);
+   #else
+    return _mm_add_pd(_mm_mul_pd(a.v, b.v), c.v);
+   #endif
+}
+
+inline SseDouble vtrunc(SseDouble a)
+{
+   #if DISTORTION_SIMD_SSE41
+    return _mm_round_pd(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+   #else
+    // There's no 64-bit conversion, adding and subtracting 2^52 rounds the
+    // magnitude to an integer, which is then rounded towards zero. Values
+    // beyond 2^52 are already integers.
+    const SseDouble magnitude = vabs(a);
+    const SseDouble shift(4503599627370496.);
+    SseDouble rounded = (magnitude + shift) - shift;
+    rounded = rounded - (SseDouble(1.) & (rounded > magnitude));
+    rounded = vselect(magnitude < shift, rounded, magnitude);
+    return _mm_or_pd(rounded.v, _mm_and_pd(a.v, _mm_set1_pd(-0.)));
+   #endif
+}
+
+inline SseDouble vfloor(SseDouble a)
+{
+   #if DISTORTION_SIMD_SSE41
+    return _mm_floor_pd(a.v);
+   #else
+    const SseDouble truncated = vtrunc(a);
+    return truncated - (SseDouble(1.) & (truncated > a));
+   #endif
+}
+
+/// Returns a * 2^n, n must be an integer in [-1022, 1023]
+inline SseDouble vldexp(SseDouble a, SseDouble n)
+{
+    const __m128i biased = _mm_add_epi32(_mm_cvtpd_epi32(n.v), _mm_set1_epi32(1023));
+    const __m128i exponent = _mm_slli_epi64(_mm_unpacklo_epi32(biased, _mm_setzero_si128()), 52);
+    return _mm_mul_pd(a.v, _mm_castsi128_pd(exponent));
+}
+
+/// Returns the mantissa of a in [0.5, 1) and sets exponent to its power of
+/// two, a must be positive and normal
+inline SseDouble vfrexp(SseDouble a, SseDouble& exponent)
+{
+    // The biased exponent goes into the low bits of 2^52 and is read back as
+    // a double, the mantissa gets the exponent of 0.5
+    const __m128i bits = _mm_castpd_si128(a.v);
+    const __m128i biased = _mm_or_si128(_mm_srli_epi64(bits, 52), _mm_castpd_si128(_mm_set1_pd(4503599627370496.)));
+    exponent = _mm_sub_pd(_mm_castsi128_pd(biased), _mm_set1_pd(4503599627370496. + 1022.));
+    const __m128i mantissa = _mm_and_si128(bits, _mm_set1_epi64x(0x000fffffffffffffLL));
+    return _mm_castsi128_pd(_mm_or_si128(mantissa, _mm_castpd_si128(_mm_set1_pd(0.5))));
+}
+
+/// Loads the four floats at p + 4 * index into a, b, c and d for each lane,
+/// widened to doubles, index must hold nonnegative integers
+inline void vgather4(const float* p, SseDouble index, SseDouble& a, SseDouble& b, SseDouble& c, SseDouble& d)
+{
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_slli_epi32(_mm_cvttpd_epi32(index.v), 2));
+
+    const __m128 r0 = _mm_loadu_ps(p + i[0]), r1 = _mm_loadu_ps(p + i[1]);
+    const __m128 low = _mm_unpacklo_ps(r0, r1);
+    const __m128 high = _mm_unpackhi_ps(r0, r1);
+    a = _mm_cvtps_pd(low);
+    b = _mm_cvtps_pd(_mm_movehl_ps(low, low));
+    c = _mm_cvtps_pd(high);
+    d = _mm_cvtps_pd(_mm_movehl_ps(high, high));
+}
+#endif
+
+#if DISTORTION_SIMD_AVX2
+//==============================================================================
+/// Eight floats in an AVX register
+struct AvxFloat
+{
+    typedef AvxFloat Mask;
+    typedef float Sample;
+    static const int size = 8;
+
+    __m256 v;
+
+    AvxFloat() {}
+    AvxFloat(__m256 r) : v(r) {}
+    explicit AvxFloat(float f) : v(_mm256_set1_ps(f)) {}
+
+    static AvxFloat load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const           { _mm256_storeu_ps(p, v); }
+};
+
+inline AvxFloat operator+(AvxFloat a, AvxFloat b)   { return _mm256_add_ps(a.v, b.v); }
+inline AvxFloat operator-(AvxFloat a, AvxFloat b)   { return _mm256_sub_ps(a.v, b.v); }
+inline AvxFloat operator*(AvxFloat a, AvxFloat b)   { return _mm256_mul_ps(a.v, b.v); }
+inline AvxFloat operator/(AvxFloat a, AvxFloat b)   { return _mm256_div_ps(a.v, b.v); }
+inline AvxFloat operator-(AvxFloat a)               { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)); }
+inline AvxFloat operator<(AvxFloat a, AvxFloat b)   { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline AvxFloat operator>(AvxFloat a, AvxFloat b)   { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline AvxFloat operator<=(AvxFloat a, AvxFloat b)  { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline AvxFloat operator>=(AvxFloat a, AvxFloat b)  { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline AvxFloat operator&(AvxFloat a, AvxFloat b)   { return _mm256_and_ps(a.v, b.v); }
+inline AvxFloat operator|(AvxFloat a, AvxFloat b)   { return _mm256_or_ps(a.v, b.v); }
+
+inline AvxFloat vmin(AvxFloat a, AvxFloat b)        { return _mm256_min_ps(a.v, b.v); }
+inline AvxFloat vmax(AvxFloat a, AvxFloat b)        { return _mm256_max_ps(a.v, b.v); }
+inline AvxFloat vabs(AvxFloat a)                    { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+inline AvxFloat vsqrt(AvxFloat a)                   { return _mm256_sqrt_ps(a.v); }
+inline AvxFloat vrsqrt(AvxFloat a)                  { return _mm256_rsqrt_ps(a.v); }
+inline AvxFloat vfloor(AvxFloat a)                  { return _mm256_floor_ps(a.v); }
+inline AvxFloat vtrunc(AvxFloat a)                  { return _mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+inline AvxFloat vselect(AvxFloat mask, AvxFloat a, AvxFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+inline AvxFloat vmuladd(AvxFloat a, AvxFloat b, AvxFloat c)
+{
+   #if DISTORTION_SIMD_FMA
+    return _mm256_fmadd_ps(a.v, b.v, c.v);
+   #else
+    return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v);
+   #endif
+}
+
+/// Returns a * 2^n, n must be an integer in [-126, 127]
+inline AvxFloat vldexp(AvxFloat a, AvxFloat n)
+{
+    const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n.v),
+                                                                _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(a.v, _mm256_castsi256_ps(exponent));
+}
+
+/// Loads the four floats at p + 4 * index into a, b, c and d for each lane,
+/// index must hold nonnegative integers. Unused gathers are dropped.
+inline void vgather4(const float* p, AvxFloat index, AvxFloat& a, AvxFloat& b, AvxFloat& c, AvxFloat& d)
+{
+    const __m256i i = _mm256_slli_epi32(_mm256_cvttps_epi32(index.v), 2);
+    a = _mm256_i32gather_ps(p, i, 4);
+    b = _mm256_i32gather_ps(p + 1, i, 4);
+    c = _mm256_i32gather_ps(p + 2, i, 4);
+    d = _mm256_i32gather_ps(p + 3, i, 4);
+}
+
+//==============================================================================
+/// Four doubles in an AVX register
+struct AvxDouble
+{
+    typedef AvxDouble Mask;
+    typedef double Sample;
+    static const int size = 4;
+
+    __m256d v;
+
+    AvxDouble() {}
+    AvxDouble(__m256d r) : v(r) {}
+    explicit AvxDouble(double d) : v(_mm256_set1_pd(d)) {}
+
+    static AvxDouble load(const double* p) { return _mm256_loadu_pd(p); }
+    void store(double* p) const            { _mm256_storeu_pd(p, v); }
+};
+
+inline AvxDouble operator+(AvxDouble a, AvxDouble b)    { return _mm256_add_pd(a.v, b.v); }
+inline AvxDouble operator-(AvxDouble a, AvxDouble b)    { return _mm256_sub_pd(a.v, b.v); }
+inline AvxDouble operator*(AvxDouble a, AvxDouble b)    { return _mm256_mul_pd(a.v, b.v); }
+inline AvxDouble operator/(AvxDouble a, AvxDouble b)    { return _mm256_div_pd(a.v, b.v); }
+inline AvxDouble operator-(AvxDouble a)                 { return _mm256_xor_pd(a.v, _mm256_set1_pd(-0.)); }
+inline AvxDouble operator<(AvxDouble a, AvxDouble b)    { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+inline AvxDouble operator>(AvxDouble a, AvxDouble b)    { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+inline AvxDouble operator<=(AvxDouble a, AvxDouble b)   { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+inline AvxDouble operator>=(AvxDouble a, AvxDouble b)   { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+inline AvxDouble operator&(AvxDouble a, AvxDouble b)    { return _mm256_and_pd(a.v, b.v); }
+inline AvxDouble operator|(AvxDouble a, AvxDouble b)    { return _mm256_or_pd(a.v, b.v); }
+
+inline AvxDouble vmin(AvxDouble a, AvxDouble b)         { return _mm256_min_pd(a.v, b.v); }
+inline AvxDouble vmax(AvxDouble a, AvxDouble b)         { return _mm256_max_pd(a.v, b.v); }
+inline AvxDouble vabs(AvxDouble a)                      { return _mm256_andnot_pd(_mm256_set1_pd(-0.), a.v); }
+inline AvxDouble vsqrt(AvxDouble a)                     { return _mm256_sqrt_pd(a.v); }
+inline AvxDouble vrsqrt(AvxDouble a)                    { return _mm256_div_pd(_mm256_set1_pd(1.), _mm256_sqrt_pd(a.v)); }
+inline AvxDouble vfloor(AvxDouble a)                    { return _mm256_floor_pd(a.v); }
+inline AvxDouble vtrunc(AvxDouble a)                    { return _mm256_round_pd(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+inline AvxDouble vselect(AvxDouble mask, AvxDouble a, AvxDouble b) { return _mm256_blendv_pd(b.v, a.v, mask.v); }
+inline bool vany(AvxDouble mask)                        { return _mm256_movemask_pd(mask.v) != 0; }
+
+inline AvxDouble vmuladd(AvxDouble a, AvxDouble b, AvxDouble c)
+{
+   #if DISTORTION_SIMD_FMA
+    return _mm256_fmadd_pd(a.v, b.v, c.v);
+   #else
+    return _mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v);
+   #endif
+}
+
+/// Returns a * 2^n, n must be an integer in [-1022, 1023]
+inline AvxDouble vldexp(AvxDouble a, AvxDouble n)
+{
+    const __m128i biased = _mm_add_epi32(_mm256_cvtpd_epi32(n.v), _mm_set1_epi32(1023));
+    const __m256i exponent = _mm256_slli_epi64(_mm256_cvtepi32_epi64(biased), 52);
+    return _mm256_mul_pd(a.v, _mm256_castsi256_pd(exponent));
+}
+
+/// Returns the mantissa of a in [0.5, 1) and sets exponent to its power of
+/// two, a must be positive and normal
+inline AvxDouble vfrexp(AvxDouble a, AvxDouble& exponent)
+{
+    const __m256i bits = _mm256_castpd_si256(a.v);
+    const __m256i biased = _mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                           _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.)));
+    exponent = _mm256_sub_pd(_mm256_castsi256_pd(biased), _mm256_set1_pd(4503599627370496. + 1022.));
+    const __m256i mantissa = _mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffLL));
+    return _mm256_castsi256_pd(_mm256_or_si256(mantissa, _mm256_castpd_si256(_mm256_set1_pd(0.5))));
+}
+
+/// Loads the four floats at p + 4 * index into a, b, c and d for each lane,
+/// widened to doubles, index must hold nonnegative integers
+inline void vgather4(const float* p, AvxDouble index, AvxDouble& a, AvxDouble& b, AvxDouble& c, AvxDouble& d)
+{
+    const __m128i i = _mm_slli_epi32(_mm256_cvttpd_epi32(index.v), 2);
+    a = _mm256_cvtps_pd(_mm_i32gather_ps(p, i, 4));
+    b = _mm256_cvtps_pd(_mm_i32gather_ps(p + 1, i, 4));
+    c = _mm256_cvtps_pd(_mm_i32gather_ps(p + 2, i, 4));
+    d = _mm256_cvtps_pd(_mm_i32gather_ps(p + 3, i, 4));
+}
+#endif
+
+#if DISTORTION_SIMD_AVX512
+//==============================================================================
+/// A lane mask for Avx512Float comparisons
+struct Avx512Mask
+{
+    __mmask16 m;
+
+    Avx512Mask(__mmask16 k) : m(k) {}
+};
+
+inline Avx512Mask operator&(Avx512Mask a, Avx512Mask b) { return static_cast<__mmask16>(a.m & b.m); }
+inline Avx512Mask operator|(Avx512Mask a, Avx512Mask b) { return static_cast<__mmask16>(a.m | b.m); }
+
+/// Sixteen floats in an AVX-512 register
+struct Avx512Float
+{
+    typedef Avx512Mask Mask;
+    typedef float Sample;
+    static const int size = 16;
+
+    __m512 v;
+
+    Avx512Float() {}
+    Avx512Float(__m512 r) : v(r) {}
+    explicit Avx512Float(float f) : v(_mm512_set1_ps(f)) {}
+
+    static Avx512Float load(const float* p) { return _mm512_loadu_ps(p); }
+    void store(float* p) const              { _mm512_storeu_ps(p, v); }
+};
+
+inline Avx512Float operator+(Avx512Float a, Avx512Float b)  { return _mm512_add_ps(a.v, b.v); }
+inline Avx512Float operator-(Avx512Float a, Avx512Float b)  { return _mm512_sub_ps(a.v, b.v); }
+inline Avx512Float operator*(Avx512Float a, Avx512Float b)  { return _mm512_mul_ps(a.v, b.v); }
+inline Avx512Float operator/(Avx512Float a, Avx512Float b)  { return _mm512_div_ps(a.v, b.v); }
+inline Avx512Float operator-(Avx512Float a)                 { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+inline Avx512Mask operator<(Avx512Float a, Avx512Float b)   { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+inline Avx512Mask operator>(Avx512Float a, Avx512Float b)   { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+inline Avx512Mask operator<=(Avx512Float a, Avx512Float b)  { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ); }
+inline Avx512Mask operator>=(Avx512Float a, Avx512Float b)  { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ); }
+
+inline Avx512Float vmin(Avx512Float a, Avx512Float b)       { return _mm512_min_ps(a.v, b.v); }
+inline Avx512Float vmax(Avx512Float a, Avx512Float b)       { return _mm512_max_ps(a.v, b.v); }
+inline Avx512Float vabs(Avx512Float a)                      { return _mm512_abs_ps(a.v); }
+inline Avx512Float vsqrt(Avx512Float a)                     { return _mm512_sqrt_ps(a.v); }
+inline Avx512Float vrsqrt(Avx512Float a)                    { return _mm512_rsqrt14_ps(a.v); }
+inline Avx512Float vfloor(Avx512Float a)                    { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF); }
+inline Avx512Float vtrunc(Avx512Float a)                    { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_ZERO); }
+inline Avx512Float vmuladd(Avx512Float a, Avx512Float b, Avx512Float c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+inline Avx512Float vldexp(Avx512Float a, Avx512Float n)     { return _mm512_scalef_ps(a.v, n.v); }
+
+/// Loads the four floats at p + 4 * index into a, b, c and d for each lane,
+/// index must hold nonnegative integers
+inline void vgather4(const float* p, Avx512Float index,
+                     Avx512Float& a, Avx512Float& b, Avx512Float& c, Avx512Float& d)
+{
+    const __m512i i = _mm512_slli_epi32(_mm512_cvttps_epi32(index.v), 2);
+    a = _mm512_i32gather_ps(i, p, 4);
+    b = _mm512_i32gather_ps(i, p + 1, 4);
+    c = _mm512_i32gather_ps(i, p + 2, 4);
+    d = _mm512_i32gather_ps(i, p + 3, 4);
+}
+
+inline Avx512Float vselect(Avx512Mask mask, Avx512Float a, Avx512Float b)
+{
+    return _mm512_mask_blend_ps(mask.m, b.v, a.v);
+}
+
+//==============================================================================
+/// A lane mask for Avx512Double comparisons
+struct Avx512DoubleMask
+{
+    __mmask8 m;
+
+    Avx512DoubleMask(__mmask8 k) : m(k) {}
+};
+
+inline Avx512DoubleMask operator&(Avx512DoubleMask a, Avx512DoubleMask b) { return static_cast<__mmask8>(a.m & b.m); }
+inline Avx512DoubleMask operator|(Avx512DoubleMask a, Avx512DoubleMask b) { return static_cast<__mmask8>(a.m | b.m); }
+
+/// Eight doubles in an AVX-512 register
+struct Avx512Double
+{
+    typedef Avx512DoubleMask Mask;
+    typedef double Sample;
+    static const int size = 8;
+
+    __m512d v;
+
+    Avx512Double() {}
+    Avx512Double(__m512d r) : v(r) {}
+    explicit Avx512Double(double d) : v(_mm512_set1_pd(d)) {}
+
+    static Avx512Double load(const double* p) { return _mm512_loadu_pd(p); }
+    void store(double* p) const               { _mm512_storeu_pd(p, v); }
+};
+
+inline Avx512Double operator+(Avx512Double a, Avx512Double b)       { return _mm512_add_pd(a.v, b.v); }
+inline Avx512Double operator-(Avx512Double a, Avx512Double b)       { return _mm512_sub_pd(a.v, b.v); }
+inline Avx512Double operator*(Avx512Double a, Avx512Double b)       { return _mm512_mul_pd(a.v, b.v); }
+inline Avx512Double operator/(Avx512Double a, Avx512Double b)       { return _mm512_div_pd(a.v, b.v); }
+inline Avx512Double operator-(Avx512Double a)                       { return _mm512_sub_pd(_mm512_setzero_pd(), a.v); }
+inline Avx512DoubleMask operator<(Avx512Double a, Avx512Double b)   { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+inline Avx512DoubleMask operator>(Avx512Double a, Avx512Double b)   { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+inline Avx512DoubleMask operator<=(Avx512Double a, Avx512Double b)  { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ); }
+inline Avx512DoubleMask operator>=(Avx512Double a, Avx512Double b)  { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ); }
+
+inline Avx512Double vmin(Avx512Double a, Avx512Double b)            { return _mm512_min_pd(a.v, b.v); }
+inline Avx512Double vmax(Avx512Double a, Avx512Double b)            { return _mm512_max_pd(a.v, b.v); }
+inline Avx512Double vabs(Avx512Double a)                            { return _mm512_abs_pd(a.v); }
+inline Avx512Double vsqrt(Avx512Double a)                           { return _mm512_sqrt_pd(a.v); }
+inline Avx512Double vrsqrt(Avx512Double a)                          { return _mm512_rsqrt14_pd(a.v); }
+inline Avx512Double vfloor(Avx512Double a)                          { return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEG_INF); }
+inline Avx512Double vtrunc(Avx512Double a)                          { return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_ZERO); }
+inline Avx512Double vmuladd(Avx512Double a, Avx512Double b, Avx512Double c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+inline Avx512Double vldexp(Avx512Double a, Avx512Double n)          { return _mm512_scalef_pd(a.v, n.v); }
+
+/// Returns the mantissa of a in [0.5, 1) and sets exponent to its power of
+/// two, a must be positive and normal
+inline Avx512Double vfrexp(Avx512Double a, Avx512Double& exponent)
+{
+    exponent = _mm512_add_pd(_mm512_getexp_pd(a.v), _mm512_set1_pd(1.));
+    return _mm512_getmant_pd(a.v, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_zero);
+}
+
+/// Loads the four floats at p + 4 * index into a, b, c and d for each lane,
+/// widened to doubles, index must hold nonnegative integers
+inline void vgather4(const float* p, Avx512Double index,
+                     Avx512Double& a, Avx512Double& b, Avx512Double& c, Avx512Double& d)
+{
+    const __m256i i = _mm256_slli_epi32(_mm512_cvttpd_epi32(index.v), 2);
+    a = _mm512_cvtps_pd(_mm256_i32gather_ps(p, i, 4));
+    b = _mm512_cvtps_pd(_mm256_i32gather_ps(p + 1, i, 4));
+    c = _mm512_cvtps_pd(_mm256_i32gather_ps(p + 2, i, 4));
+    d = _mm512_cvtps_pd(_mm256_i32gather_ps(p + 3, i, 4));
+}
+
+inline Avx512Double vselect(Avx512DoubleMask mask, Avx512Double a, Avx512Double b)
+{
+    return _mm512_mask_blend_pd(mask.m, b.v, a.v);
+}
+
+inline bool vany(Avx512DoubleMask mask)                 { return mask.m != 0; }
+#endif
+
+//==============================================================================
+// Transcendental approximations, written once over the operations above
+
+/** Exponential for float lanes, after the Cephes expf
+
+    Relative error is within 2 ulp over the clamped domain [-87, 88].
+ */
+template <typename V>
+inline V vexp(V x, float)
+{
+    x = vmin(vmax(x, V(-87.f)), V(88.f));
+
+    // e^x = 2^n * e^r, with |r| <= ln(2) / 2
+    const V n = vfloor(vmuladd(x, V(1.44269504088896341f), V(0.5f)));
+    x = x - n * V(0.693359375f);
+    x = x + n * V(2.12194440e-4f);
+
+    V y = V(1.9875691500e-4f);
+    y = vmuladd(y, x, V(1.3981999507e-3f));
+    y = vmuladd(y, x, V(8.3334519073e-3f));
+    y = vmuladd(y, x, V(4.1665795894e-2f));
+    y = vmuladd(y, x, V(1.6666665459e-1f));
+    y = vmuladd(y, x, V(5.0000001201e-1f));
+    y = vmuladd(y, x * x, x) + V(1.f);
+
+    return vldexp(y, n);
+}
+
+/** Exponential, a degree 4 minimax polynomial in place of vexp's degree 7
+
+    Relative error is within 3e-6 over the clamped domain [-87, 88].
+ */
+template <typename V>
+inline V vexpFast(V x)
+{
+    x = vmin(vmax(x, V(-87.f)), V(88.f));
+
+    // e^x = 2^n * e^r, with |r| <= ln(2) / 2
+    const V n = vfloor(vmuladd(x, V(1.44269504088896341f), V(0.5f)));
+    const V r = vmuladd(n, V(-0.693147180559945309f), x);
+
+    V y = V(4.14586082e-2f);
+    y = vmuladd(y, r, V(1.67909072e-1f));
+    y = vmuladd(y, r, V(5.00043587e-1f));
+    y = vmuladd(y, r, V(9.99963405e-1f));
+    y = vmuladd(y, r, V(9.99999261e-1f));
+
+    return vldexp(y, n);
+}
+
+/** Sine, reduced to [-PI / 2, PI / 2] by whole half turns
+
+    The half turn is split in two so the reduction stays exact for the first
+    few thousand turns, then an odd minimax polynomial of degree 9. Absolute
+    error is within 2e-7 for |x| < 1000.
+ */
+template <typename V>
+inline V vsin(V x)
+{
+    // sin(x) = (-1)^n * sin(r), with x = n * PI + r
+    const V n = vfloor(vmuladd(x, V(0.318309886183790672f), V(0.5f)));
+    V r = x - n * V(3.140625f);
+    r = r - n * V(9.67653589793e-4f);
+    const V z = r * r;
+
+    V y = V(2.61253804e-6f);
+    y = vmuladd(y, z, V(-1.98134239e-4f));
+    y = vmuladd(y, z, V(8.33313078e-3f));
+    y = vmuladd(y, z, V(-1.66666625e-1f));
+    y = vmuladd(y * z, r, r);
+
+    const V odd = n - V(2.f) * vfloor(n * V(0.5f));
+    return vselect(odd > V(0.f), -y, y);
+}
+
+/** Arctangent for float lanes, after the Cephes atanf
+
+    The argument is reduced to [-tan(PI / 8), tan(PI / 8)] before evaluating
+    the polynomial. Absolute error is within 2e-7 over the whole real line.
+ */
+template <typename V>
+inline V vatan(V x, float)
+{
+    const V ax = vabs(x);
+    const typename V::Mask big = ax > V(2.414213562373095f);
+    const typename V::Mask mid = ax > V(0.4142135623730950f);
+
+    // atan(x) = PI / 2 + atan(-1 / x) when big, PI / 4 + atan((x - 1) / (x + 1)) when mid
+    const V numerator = vselect(big, V(-1.f), vselect(mid, ax - V(1.f), ax));
+    const V denominator = vselect(big, ax, vselect(mid, ax + V(1.f), V(1.f)));
+    const V offset = vselect(big, V(1.5707963267948966f), vselect(mid, V(0.7853981633974483f), V(0.f)));
+    const V r = numerator / denominator;
+    const V z = r * r;
+
+    V y = V(8.05374449538e-2f);
+    y = vmuladd(y, z, V(-1.38776856032e-1f));
+    y = vmuladd(y, z, V(1.99777106478e-1f));
+    y = vmuladd(y, z, V(-3.33329491539e-1f));
+    y = offset + vmuladd(y * z, r, r);
+
+    return vselect(x < V(0.f), -y, y);
+}
+
+/** Arctangent, a minimax polynomial in place of the Cephes reduction
+
+    The argument is reduced to [-1, 1] with atan(x) = PI / 2 - atan(1 / x),
+    one division and no table of ranges, then an odd polynomial of degree
+    11 fitted for the least maximum error. Absolute error is within 1.1e-5
+    over the whole real line, against 2e-7 for vatan.
+ */
+template <typename V>
+inline V vatanFast(V x)
+{
+    const V ax = vabs(x);
+    const V r = vmin(ax, V(1.f)) / vmax(ax, V(1.f));
+    const V z = r * r;
+
+    V y = V(-1.5571614e-2f);
+    y = vmuladd(y, z, V(6.3059455e-2f));
+    y = vmuladd(y, z, V(-1.2640005e-1f));
+    y = vmuladd(y, z, V(1.9753690e-1f));
+    y = vmuladd(y, z, V(-3.3322609e-1f));
+    y = vmuladd(y, z, V(9.9999957e-1f)) * r;
+    y = vselect(ax > V(1.f), V(1.5707963267948966f) - y, y);
+
+    return vselect(x < V(0.f), -y, y);
+}
+
+/** Arctangent in double precision, after the Cephes atan
+
+    For doubles and double vectors, where the single precision polynomials
+    of vatan aren't enough. The argument is reduced like vatan, with the
+    middle range from 0.66, then a rational function of degree 4 over 5 in
+    its square. Relative error is within 2e-16.
+ */
+template <typename V>
+inline V vatanDouble(V x)
+{
+    const V ax = vabs(x);
+    const auto big = ax > V(2.41421356237309504880);
+    const auto mid = ax > V(0.66);
+
+    const V numerator = vselect(big, V(-1.), vselect(mid, ax - V(1.), ax));
+    const V denominator = vselect(big, ax, vselect(mid, ax + V(1.), V(1.)));
+    const V offset = vselect(big, V(1.57079632679489661923), vselect(mid, V(0.78539816339744830962), V(0.)));
+    // The low bits of PI / 2 and PI / 4
+    const V correction = vselect(big, V(6.123233995736765886130e-17), vselect(mid, V(3.061616997868382943065e-17), V(0.)));
+    const V r = numerator / denominator;
+    const V z = r * r;
+
+    V p = V(-8.750608600031904122785e-1);
+    p = vmuladd(p, z, V(-1.615753718733365076637e1));
+    p = vmuladd(p, z, V(-7.500855792314704667340e1));
+    p = vmuladd(p, z, V(-1.228866684490136173410e2));
+    p = vmuladd(p, z, V(-6.485021904942025371773e1));
+
+    V q = z + V(2.485846490142306297962e1);
+    q = vmuladd(q, z, V(1.650270098316988542046e2));
+    q = vmuladd(q, z, V(4.328810604912902668951e2));
+    q = vmuladd(q, z, V(4.853903996359136964868e2));
+    q = vmuladd(q, z, V(1.945506571482613964425e2));
+
+    const V y = offset + (vmuladd(r, z * p / q, r) + correction);
+    return vselect(x < V(0.), -y, y);
+}
+
+/** Exponential in double precision, after the Cephes exp
+
+    For doubles and double vectors, where the single precision polynomial of
+    vexp isn't enough. The argument is clamped to [-708, 709] and reduced
+    like vexp, then e^r = 1 + 2r P(r^2) / (Q(r^2) - r P(r^2)) with P of
+    degree 2 and Q of degree 3. Relative error is within 4e-16.
+ */
+template <typename V>
+inline V vexpDouble(V x)
+{
+    x = vmin(vmax(x, V(-708.)), V(709.));
+
+    // e^x = 2^n * e^r, with |r| <= ln(2) / 2 and ln(2) split in two
+    const V n = vfloor(vmuladd(x, V(1.4426950408889634073599), V(0.5)));
+    x = x - n * V(6.93145751953125e-1);
+    x = x - n * V(1.42860682030941723212e-6);
+    const V z = x * x;
+
+    V p = V(1.26177193074810590878e-4);
+    p = vmuladd(p, z, V(3.02994407707441961300e-2));
+    p = vmuladd(p, z, V(9.99999999999999999910e-1)) * x;
+
+    V q = V(3.00198505138664455042e-6);
+    q = vmuladd(q, z, V(2.52448340349684104192e-3));
+    q = vmuladd(q, z, V(2.27265548208155028766e-1));
+    q = vmuladd(q, z, V(2.00000000000000000009e0));
+
+    const V y = V(1.) + V(2.) * (p / (q - p));
+    return vldexp(y, n);
+}
+
+/** Natural logarithm in double precision, after the Cephes log
+
+    For doubles and double vectors, x must be positive and normal. The
+    mantissa is reduced to [sqrt(1/2), sqrt(2)), then a rational function of
+    degree 5 over 5 in its distance from 1. Relative error is within 2e-16.
+ */
+template <typename V>
+inline V vlogDouble(V x)
+{
+    V e;
+    V m = vfrexp(x, e);
+
+    // log(m * 2^e) = log(2m) + (e - 1) log(2) below sqrt(1/2)
+    const auto low = m < V(0.70710678118654752440);
+    e = vselect(low, e - V(1.), e);
+    m = vselect(low, m + m - V(1.), m - V(1.));
+    const V z = m * m;
+
+    V p = V(1.01875663804580931796e-4);
+    p = vmuladd(p, m, V(4.97494994976747001425e-1));
+    p = vmuladd(p, m, V(4.70579119878881725854e0));
+    p = vmuladd(p, m, V(1.44989225341610930846e1));
+    p = vmuladd(p, m, V(1.79368678507819816313e1));
+    p = vmuladd(p, m, V(7.70838733755885391666e0));
+
+    V q = m + V(1.12873587189167450590e1);
+    q = vmuladd(q, m, V(4.52279145837532221105e1));
+    q = vmuladd(q, m, V(8.29875266912776603211e1));
+    q = vmuladd(q, m, V(7.11544750618563894466e1));
+    q = vmuladd(q, m, V(2.31251620126765340583e1));
+
+    // log(2) split in two, so e * log(2) stays exact
+    V y = m * (z * p / q) - e * V(2.121944400546905827679e-4);
+    y = y - V(0.5) * z;
+    return (m + y) + e * V(0.693359375);
+}
+
+/// Double lanes forward to vexpDouble
+template <typename V>
+inline V vexp(V x, double)
+{
+    return vexpDouble(x);
+}
+
+/// Double lanes forward to vatanDouble
+template <typename V>
+inline V vatan(V x, double)
+{
+    return vatanDouble(x);
+}
+
+/// Exponential at the precision of the vector's lanes
+template <typename V>
+inline V vexp(V x)
+{
+    return vexp(x, typename V::Sample());
+}
+
+/// Arctangent at the precision of the vector's lanes
+template <typename V>
+inline V vatan(V x)
+{
+    return vatan(x, typename V::Sample());
+}
+
+}
+
+#endif  // SIMDVECTOR_H_INCLUDED
@@ -0,0 +1,66 @@
+#ifndef SPSCQUEUE_H_INCLUDED
+#define SPSCQUEUE_H_INCLUDED
+
+#include <atomic>
+
+/**
+    A bounded first-in first-out queue of T from a writer thread to a reader
+    thread, without locks.
+
+    The values live in a ring of Capacity slots, a power of two. The writer
+    only moves the tail and the reader only moves the head, so neither side
+    ever waits on the other. Pushing to a full queue fails instead of
+    overwriting, nothing is allocated after construction.
+
+    There must be a single writer and a single reader at a time, guard the
+    writer with a lock if several threads write.
+ */
+template <typename T, int Capacity>
+class SpscQueue
+{
+public:
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "The capacity must be a power of two");
+
+    SpscQueue()
+    : head(0), tail(0)
+    {
+    }
+
+    /// Appends a value, called by the writer. Returns false if the queue is
+    /// full.
+    bool push(const T& value)
+    {
+        const unsigned int currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == static_cast<unsigned int>(Capacity)) {
+            return false;
+        }
+        slots[currentTail & indexMask] = value;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Removes the oldest value into value, called by the reader. Returns
+    /// false if the queue is empty.
+    bool pop(T& value)
+    {
+        const unsigned int currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[currentHead & indexMask];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static const unsigned int indexMask = Capacity - 1;
+
+    T slots[Capacity];
+    // Count every pop and push, only their difference and the low bits are
+    // used, so wrapping around is harmless
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+};
+
+#endif  // SPSCQUEUE_H_INCLUDED
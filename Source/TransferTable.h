@@ -0,0 +1,105 @@
+#ifndef TRANSFERTABLE_H_INCLUDED
+#define TRANSFERTABLE_H_INCLUDED
+
+#include <vector>
+
+/**
+    A transfer curve sampled into a table, for curves too expensive to compute
+    per sample.
+
+    The curve is sampled at evenly spaced points over [minimum, maximum] along
+    with its slope. Each interval between two points stores four coefficients
+    side by side, so a lookup is a single 16 byte load per sample:
+
+        y0, y1 - y0, k2, k3
+
+    The first two give linear interpolation, y0 + t * (y1 - y0). All four give
+    the cubic Hermite spline through the values and slopes of both points,
+    y0 + t * ((y1 - y0) + (t - 1) * (k2 + k3 * t)). The lookups themselves live
+    with the kernels, see DistortionKernels.h.
+
+    Inputs outside the domain are clamped to it, the last interval is only
+    ever read at its start.
+
+    Memory is only allocated by allocate(), build() can run on the audio
+    thread.
+ */
+class TransferTable
+{
+public:
+    /// The number of points used by Distortion, 1/32 apart over [-128, 128]
+    static const int defaultNumPoints = 8193;
+
+    /// The coefficients stored per interval
+    static const int stride = 4;
+
+    TransferTable() {}
+
+    /// Allocates room for numPoints points over the domain
+    void allocate(int newNumPoints)
+    {
+        numPoints = newNumPoints;
+        coefficients.assign(static_cast<size_t>(numPoints * stride), 0.f);
+        built = false;
+    }
+
+    /** Samples a curve, a function of a double, over [newMinimum, newMaximum]
+
+        The slopes are taken by central differences, in units of the point
+        spacing.
+     */
+    template <typename Function>
+    void build(Function curve, float newMinimum, float newMaximum)
+    {
+        minimum = newMinimum;
+        maximum = newMaximum;
+
+        const double step = (static_cast<double>(maximum) - minimum) / (numPoints - 1);
+        const double h = step * 1e-3;
+        scale = static_cast<float>(1. / step);
+
+        auto slope = [&] (double x) {
+            return (curve(x + h) - curve(x - h)) / (2. * h) * step;
+        };
+
+        double x = minimum;
+        double y0 = curve(x), d0 = slope(x);
+        for (int i = 0; i < numPoints; ++i) {
+            x = minimum + (i + 1) * step;
+            const double y1 = curve(x), d1 = slope(x);
+            const double delta = y1 - y0;
+
+            float* interval = coefficients.data() + i * stride;
+            interval[0] = static_cast<float>(y0);
+            interval[1] = static_cast<float>(delta);
+            interval[2] = static_cast<float>(delta - d0);
+            interval[3] = static_cast<float>(d0 + d1 - 2. * delta);
+
+            y0 = y1;
+            d0 = d1;
+        }
+        built = true;
+    }
+
+    /// Returns true once a curve has been sampled
+    bool isBuilt() const                { return built; }
+
+    /// Returns the coefficients, stride floats per interval
+    const float* getCoefficients() const { return coefficients.data(); }
+
+    int getNumPoints() const            { return numPoints; }
+    float getMinimum() const            { return minimum; }
+
+    /// Returns the number of points per unit of input
+    float getScale() const              { return scale; }
+
+private:
+    std::vector<float> coefficients;
+    int numPoints = 0;
+    float minimum = 0.f;
+    float maximum = 0.f;
+    float scale = 0.f;
+    bool built = false;
+};
+
+#endif  // TRANSFERTABLE_H_INCLUDED
@@ -0,0 +1,47 @@
+#include "TransferTableCache.h"
+
+TransferTableCache& TransferTableCache::getInstance()
+{
+    static TransferTableCache instance;
+    return instance;
+}
+
+std::shared_ptr<const TransferTable> TransferTableCache::getTable(const Key& key, Curve curve,
+                                                                  float minimum, float maximum)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    const auto found = tables.find(key);
+    if (found != tables.end()) {
+        if (std::shared_ptr<const TransferTable> table = found->second.lock()) {
+            return table;
+        }
+    }
+
+    // Drop the tables nobody uses anymore while we're here
+    for (auto entry = tables.begin(); entry != tables.end();) {
+        if (entry->second.expired()) {
+            entry = tables.erase(entry);
+        }
+        else {
+            ++entry;
+        }
+    }
+
+    std::shared_ptr<TransferTable> table = std::make_shared<TransferTable>();
+    table->allocate(key.numPoints);
+    table->build(curve, minimum, maximum);
+    tables[key] = table;
+    return table;
+}
+
+int TransferTableCache::getNumTables()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    int numTables = 0;
+    for (const auto& entry : tables) {
+        numTables += entry.second.expired() ? 0 : 1;
+    }
+    return numTables;
+}
@@ -0,0 +1,65 @@
+#ifndef TRANSFERTABLECACHE_H_INCLUDED
+#define TRANSFERTABLECACHE_H_INCLUDED
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "TransferTable.h"
+
+/**
+    Process-wide cache of the sampled curves, shared by every Distortion.
+
+    Each table is built once, by the first instance that asks for it, and
+    handed out as a read-only shared pointer. The cache itself only keeps weak
+    references, so a table is freed with the last instance using it. Sessions
+    with many instances then hold a single copy of each curve, and the
+    instances prepared after the first skip sampling it.
+
+    Tables are looked up and built under a lock, so only call getTable() off
+    the audio thread, e.g. from Distortion::prepare().
+ */
+class TransferTableCache
+{
+public:
+    /// A curve to sample, see TransferTable::build()
+    typedef double (*Curve)(double);
+
+    /// What tells the tables apart
+    struct Key
+    {
+        int mode;
+        float shape;
+        int numPoints;
+
+        bool operator<(const Key& other) const
+        {
+            if (mode != other.mode) {
+                return mode < other.mode;
+            }
+            if (shape != other.shape) {
+                return shape < other.shape;
+            }
+            return numPoints < other.numPoints;
+        }
+    };
+
+    /// Returns the cache shared by the whole process
+    static TransferTableCache& getInstance();
+
+    /// Returns the table for a key, sampling the curve over [minimum, maximum]
+    /// if no instance holds it yet
+    std::shared_ptr<const TransferTable> getTable(const Key& key, Curve curve,
+                                                  float minimum, float maximum);
+
+    /// Returns the number of tables currently alive
+    int getNumTables();
+
+private:
+    TransferTableCache() {}
+
+    std::mutex lock;
+    std::map<Key, std::weak_ptr<const TransferTable>> tables;
+};
+
+#endif  // TRANSFERTABLECACHE_H_INCLUDED
@@ -0,0 +1,469 @@
+/**
+    Offline analysis of the aliasing, distortion, accuracy and cost of every
+    distortion mode.
+
+    Each mode is driven with a stepped sine sweep and a multitone signal, at
+    several drives and in several variants: the reference and fast curves,
+    the curve tables, anti-aliasing and oversampling. The output is written
+    as JSON, see readme.md.
+
+    Every signal is periodic over the FFT size, with its tones on odd bins k
+    times an odd spacing g. The nonlinearity and the filters settle within
+    the first period, so the next one is periodic too and its spectrum needs
+    no window: every component falls on a single bin. Harmonics and
+    intermodulation products below Nyquist then land on multiples of g, while
+    a product past Nyquist folds back to jN - c, which isn't a multiple of g
+    as N is a power of two and g is odd. So, leaving out DC:
+
+        tones      the bins of the input tones
+        distortion the other multiples of g, THD relative to the tones
+        aliasing   everything else, including the noise floor, relative to
+                   the whole output
+
+    Without oversampling or anti-aliasing, which filter and delay the signal,
+    the output is also compared sample by sample with a double precision
+    reference: the scalar double kernels with the reference curves.
+ */
+
+#include "Distortion.h"
+#include "DistortionDispatch.h"
+#include "ScopedFlushDenormals.h"
+#include "CommandLine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// How the nonlinearity is evaluated. The anti-aliased and oversampled
+    /// variants use the plugin's defaults otherwise, the fast curves and
+    /// Hermite tables.
+    struct Variant
+    {
+        const char* name;
+        Distortion::Accuracy accuracy;
+        Distortion::CurveTables curveTables;
+        Distortion::Antialiasing antialiasing;
+        int oversamplingStages;
+    };
+
+    const Variant variants[] = {
+        { "reference",      Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::noAntialiasing,          0 },
+        { "fast",           Distortion::fastAccuracy,      Distortion::noCurveTables,      Distortion::noAntialiasing,          0 },
+        { "linearTable",    Distortion::referenceAccuracy, Distortion::linearCurveTables,  Distortion::noAntialiasing,          0 },
+        { "hermiteTable",   Distortion::referenceAccuracy, Distortion::hermiteCurveTables, Distortion::noAntialiasing,          0 },
+        { "adaa1",          Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::firstOrderAntialiasing,  0 },
+        { "adaa2",          Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::secondOrderAntialiasing, 0 },
+        { "oversampling2x", Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::noAntialiasing,          1 },
+        { "oversampling4x", Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::noAntialiasing,          2 },
+        { "oversampling8x", Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::noAntialiasing,          3 }
+    };
+
+    const double sampleRate = 48000.;
+    const int fftSize = 16384;
+    const int blockSize = 512;
+
+    // The frequencies of the sine sweep
+    const double sweepFrequencies[] = { 100., 1000., 5000., 10000. };
+
+    // The multitone signal, tones on multiples of an odd spacing, 0.2 each
+    const int multitoneSpacing = 37;
+    const int multitoneMultiples[] = { 3, 11, 31, 67, 137 };
+    const double multitoneAmplitude = 0.2;
+
+    const double sineAmplitude = 0.5;
+
+    /// A test signal, one period of fftSize samples
+    struct Signal
+    {
+        std::string name;
+        // The frequency of a sine, 0 for the multitone
+        double frequency;
+        int spacing;
+        std::vector<int> bins;
+        std::vector<float> samples;
+    };
+
+    Signal makeSignal(const std::string& name, int spacing, const std::vector<int>& bins, double amplitude)
+    {
+        Signal signal;
+        signal.name = name;
+        signal.spacing = spacing;
+        signal.bins = bins;
+        signal.frequency = bins.size() == 1 ? bins[0] * sampleRate / fftSize : 0.;
+        signal.samples.resize(fftSize);
+
+        for (int i = 0; i < fftSize; ++i) {
+            double sample = 0.;
+            for (int bin : bins) {
+                // Reduced to a whole period first, so the phase is exact
+                const long long phase = (static_cast<long long>(bin) * i) % fftSize;
+                sample += amplitude * std::sin(2. * PI * static_cast<double>(phase) / fftSize);
+            }
+            signal.samples[i] = static_cast<float>(sample);
+        }
+        return signal;
+    }
+
+    std::vector<Signal> makeSignals()
+    {
+        std::vector<Signal> signals;
+        for (double frequency : sweepFrequencies) {
+            // The nearest odd bin, its own spacing
+            int bin = static_cast<int>(std::lround(frequency * fftSize / sampleRate));
+            bin |= 1;
+            signals.push_back(makeSignal("sine", bin, { bin }, sineAmplitude));
+        }
+
+        std::vector<int> bins;
+        for (int multiple : multitoneMultiples) {
+            bins.push_back(multiple * multitoneSpacing);
+        }
+        signals.push_back(makeSignal("multitone", multitoneSpacing, bins, multitoneAmplitude));
+        return signals;
+    }
+
+    /// An in-place radix-2 FFT, the size a power of two
+    void fft(std::vector<std::complex<double>>& data)
+    {
+        const size_t size = data.size();
+        for (size_t i = 1, j = 0; i < size; ++i) {
+            size_t bit = size >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(data[i], data[j]);
+            }
+        }
+
+        for (size_t length = 2; length <= size; length <<= 1) {
+            const double angle = -2. * PI / static_cast<double>(length);
+            for (size_t start = 0; start < size; start += length) {
+                for (size_t k = 0; k < length / 2; ++k) {
+                    const std::complex<double> twiddle = std::polar(1., angle * static_cast<double>(k));
+                    const std::complex<double> even = data[start + k];
+                    const std::complex<double> odd = data[start + k + length / 2] * twiddle;
+                    data[start + k] = even + odd;
+                    data[start + k + length / 2] = even - odd;
+                }
+            }
+        }
+    }
+
+    /// The power of the output split by where it falls, see the top of the
+    /// file
+    struct Spectrum
+    {
+        double tones;
+        double distortion;
+        double aliasing;
+
+        double getTotal() const     { return tones + distortion + aliasing; }
+    };
+
+    Spectrum analyse(const Signal& signal, const std::vector<float>& output)
+    {
+        std::vector<std::complex<double>> data(output.begin(), output.end());
+        fft(data);
+
+        Spectrum spectrum = { 0., 0., 0. };
+        for (int bin = 1; bin <= fftSize / 2; ++bin) {
+            const double power = std::norm(data[bin]);
+            if (std::find(signal.bins.begin(), signal.bins.end(), bin) != signal.bins.end()) {
+                spectrum.tones += power;
+            }
+            else if (bin % signal.spacing == 0) {
+                spectrum.distortion += power;
+            }
+            else {
+                spectrum.aliasing += power;
+            }
+        }
+        return spectrum;
+    }
+
+    /// Returns a power ratio in dB, floored so it stays a JSON number
+    double toDecibels(double power, double reference)
+    {
+        if (power <= 0. || reference <= 0.) {
+            return -300.;
+        }
+        return std::max(10. * std::log10(power / reference), -300.);
+    }
+
+    void setup(Distortion& distortion, int mode, float drive)
+    {
+        distortion.controls.mode = mode;
+        distortion.controls.drive = drive;
+        distortion.controls.threshold = 0.5f;
+        distortion.controls.mix = 1.f;
+        distortion.controls.shape = 0.5f;
+        distortion.prepare(sampleRate, blockSize, 1);
+        distortion.setSmoothing(ParameterSmoother::linear, 0.);
+    }
+
+    /// Processes the periodic signal in blocks, from and to any offset
+    template <typename Sample>
+    void process(Distortion& distortion, const std::vector<Sample>& input, std::vector<Sample>& output)
+    {
+        for (int start = 0; start < fftSize; start += blockSize) {
+            const int numSamples = std::min(blockSize, fftSize - start);
+            distortion.processBlock(0, input.data() + start, output.data() + start, numSamples);
+        }
+    }
+
+    /// The output of the double precision reference, one period after the
+    /// first
+    std::vector<double> getReference(int mode, float drive, const Signal& signal)
+    {
+        Distortion distortion;
+        setup(distortion, mode, drive);
+        distortion.setKernelSet(*DistortionKernels::getScalarKernelSet());
+        distortion.setAccuracy(Distortion::referenceAccuracy);
+        distortion.setCurveTables(Distortion::noCurveTables);
+        distortion.reset();
+
+        const std::vector<double> input(signal.samples.begin(), signal.samples.end());
+        std::vector<double> output(fftSize);
+        process(distortion, input, output);
+        process(distortion, input, output);
+        return output;
+    }
+
+    struct Result
+    {
+        Spectrum spectrum;
+        double maximumError;
+        double rmsError;
+        double nanosecondsPerSample;
+    };
+
+    const int timedPeriods = 5;
+
+    Result measure(const DistortionKernels::KernelSet& kernelSet, const Variant& variant,
+                   int mode, float drive, const Signal& signal)
+    {
+        Distortion distortion;
+        setup(distortion, mode, drive);
+        distortion.setKernelSet(kernelSet);
+        distortion.setAccuracy(variant.accuracy);
+        distortion.setCurveTables(variant.curveTables);
+        distortion.setAntialiasing(variant.antialiasing);
+        distortion.setOversampling(variant.oversamplingStages, Oversampler::medium);
+        distortion.reset();
+
+        // The first period settles, the fastest of the others is the cost
+        std::vector<float> output(fftSize);
+        process(distortion, signal.samples, output);
+
+        Result result;
+        result.nanosecondsPerSample = 0.;
+        for (int period = 0; period < timedPeriods; ++period) {
+            const auto start = std::chrono::steady_clock::now();
+            process(distortion, signal.samples, output);
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            const double nanoseconds = elapsed.count() / fftSize;
+            if (period == 0 || nanoseconds < result.nanosecondsPerSample) {
+                result.nanosecondsPerSample = nanoseconds;
+            }
+        }
+
+        result.spectrum = analyse(signal, output);
+
+        result.maximumError = -1.;
+        result.rmsError = -1.;
+        if (variant.antialiasing == Distortion::noAntialiasing && variant.oversamplingStages == 0) {
+            const std::vector<double> reference = getReference(mode, drive, signal);
+            double maximum = 0., sum = 0.;
+            for (int i = 0; i < fftSize; ++i) {
+                const double error = std::fabs(output[i] - reference[i]);
+                maximum = std::max(maximum, error);
+                sum += error * error;
+            }
+            result.maximumError = maximum;
+            result.rmsError = std::sqrt(sum / fftSize);
+        }
+        return result;
+    }
+
+    struct Settings
+    {
+        std::string kernelSet;
+        std::vector<std::string> variants;
+        std::vector<int> modes;
+        std::vector<float> drives;
+        std::string outputPath;
+    };
+
+    void printUsage()
+    {
+        std::fprintf(stderr,
+            "Usage: distortion-analysis [options]\n"
+            "\n"
+            "  --kernels NAME       the kernel set (default: the fastest supported)\n"
+            "  --variants LIST      reference, fast, linearTable, hermiteTable, adaa1, adaa2,\n"
+            "                       oversampling2x, oversampling4x, oversampling8x\n"
+            "  --modes LIST         modes, e.g. 2,8 (default: 1 to %d)\n"
+            "  --drives LIST        drives (default: 1,4,16)\n"
+            "  --output PATH        write the JSON there instead of to stdout\n",
+            Distortion::numModes - 1);
+    }
+
+    bool parseArguments(int argc, char* argv[], Settings& settings)
+    {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const char* option = argv[i];
+            const char* value = argv[i + 1];
+
+            if (std::strcmp(option, "--kernels") == 0) {
+                settings.kernelSet = value;
+            }
+            else if (std::strcmp(option, "--variants") == 0) {
+                settings.variants = CommandLine::split(value);
+            }
+            else if (std::strcmp(option, "--modes") == 0) {
+                settings.modes = CommandLine::splitNumbers<int>(value);
+            }
+            else if (std::strcmp(option, "--drives") == 0) {
+                settings.drives = CommandLine::splitNumbers<float>(value);
+            }
+            else if (std::strcmp(option, "--output") == 0) {
+                settings.outputPath = value;
+            }
+            else {
+                return false;
+            }
+        }
+
+        for (int mode : settings.modes) {
+            if (mode < 0 || mode >= Distortion::numModes) {
+                return false;
+            }
+        }
+        return argc % 2 == 1;
+    }
+
+    /// Prints a value that may be missing, marked by a negative value
+    void writeOptional(std::FILE* file, const char* name, double value)
+    {
+        if (value < 0.) {
+            std::fprintf(file, "\"%s\": null", name);
+        }
+        else {
+            std::fprintf(file, "\"%s\": %.6g", name, value);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    settings.kernelSet = DistortionKernels::selectKernelSet().name;
+    for (const Variant& variant : variants) {
+        settings.variants.push_back(variant.name);
+    }
+    for (int mode = 1; mode < Distortion::numModes; ++mode) {
+        settings.modes.push_back(mode);
+    }
+    settings.drives = { 1.f, 4.f, 16.f };
+
+    if (!parseArguments(argc, argv, settings)) {
+        printUsage();
+        return 2;
+    }
+
+    const DistortionKernels::KernelSet* kernelSet = DistortionKernels::findKernelSet(settings.kernelSet.c_str());
+    if (kernelSet == nullptr) {
+        std::fprintf(stderr, "The %s kernels aren't supported here\n", settings.kernelSet.c_str());
+        return 1;
+    }
+
+    std::FILE* file = stdout;
+    if (!settings.outputPath.empty()) {
+        file = std::fopen(settings.outputPath.c_str(), "w");
+        if (file == nullptr) {
+            std::fprintf(stderr, "Can't write %s\n", settings.outputPath.c_str());
+            return 1;
+        }
+    }
+
+    const std::vector<Signal> signals = makeSignals();
+
+    // As in the plugin
+    const ScopedFlushDenormals flushDenormals;
+
+    std::fprintf(file, "{\n");
+    std::fprintf(file, "  \"analysis\": \"distortion\",\n");
+    std::fprintf(file, "  \"kernelSet\": \"%s\",\n", kernelSet->name);
+    std::fprintf(file, "  \"sampleRate\": %g,\n", sampleRate);
+    std::fprintf(file, "  \"fftSize\": %d,\n", fftSize);
+    std::fprintf(file, "  \"blockSize\": %d,\n", blockSize);
+    std::fprintf(file, "  \"results\": [");
+
+    std::fprintf(stderr, "mode  %-15s %13s %11s %11s\n", "variant", "aliasing (dB)", "max error", "ns/sample");
+
+    bool first = true;
+    for (int mode : settings.modes) {
+
+        for (const Variant& variant : variants) {
+            if (std::find(settings.variants.begin(), settings.variants.end(), variant.name) == settings.variants.end()) {
+                continue;
+            }
+            // The worst over every drive and signal
+            double worstAliasing = -300., worstError = -1., worstCost = 0.;
+
+            for (float drive : settings.drives) {
+                for (const Signal& signal : signals) {
+                    const Result result = measure(*kernelSet, variant, mode, drive, signal);
+                    const Spectrum& spectrum = result.spectrum;
+
+                    worstAliasing = std::max(worstAliasing, toDecibels(spectrum.aliasing, spectrum.getTotal()));
+                    worstError = std::max(worstError, result.maximumError);
+                    worstCost = std::max(worstCost, result.nanosecondsPerSample);
+
+                    std::fprintf(file, "%s\n    {\"mode\": %d, \"variant\": \"%s\", \"drive\": %g, "
+                                 "\"signal\": \"%s\", ",
+                                 first ? "" : ",", mode, variant.name, drive, signal.name.c_str());
+                    if (signal.frequency > 0.) {
+                        std::fprintf(file, "\"frequency\": %.6g,\n     ", signal.frequency);
+                    }
+                    else {
+                        std::fprintf(file, "\"frequency\": null,\n     ");
+                    }
+                    std::fprintf(file, "\"thdDb\": %.2f, \"aliasingDb\": %.2f, ",
+                                 toDecibels(spectrum.distortion, spectrum.tones),
+                                 toDecibels(spectrum.aliasing, spectrum.getTotal()));
+                    writeOptional(file, "maxError", result.maximumError);
+                    std::fprintf(file, ", ");
+                    writeOptional(file, "rmsError", result.rmsError);
+                    std::fprintf(file, ", \"nsPerSample\": %.4g}", result.nanosecondsPerSample);
+                    first = false;
+                }
+            }
+
+            std::fprintf(stderr, "%4d  %-15s %13.1f ", mode, variant.name, worstAliasing);
+            if (worstError < 0.) {
+                std::fprintf(stderr, "%11s ", "-");
+            }
+            else {
+                std::fprintf(stderr, "%11.2g ", worstError);
+            }
+            std::fprintf(stderr, "%11.2f\n", worstCost);
+        }
+    }
+
+    std::fprintf(file, "\n  ]\n}\n");
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,366 @@
+/**
+    Headless benchmark of the distortion kernels.
+
+    Links the DSP sources without the plugin wrapper or JUCE, and times
+    Distortion::processBlock on one channel for every mode, kernel set,
+    variant, block size and drive. Each case is run a number of times, and
+    every run processes the same number of samples in blocks of the block
+    size, from a buffer of noise. The results are written as JSON, with the
+    time per sample of every run and their median and median absolute
+    deviation. See readme.md.
+
+    The variants are the reference curves, the fast curves, the linear and
+    Hermite curve tables and first and second order anti-aliasing. A variant
+    that doesn't apply to a mode runs its reference kernels, e.g. the fast
+    variant of the hard clip.
+
+    Cycles are read from the time stamp counter on x86, which ticks at a
+    constant rate rather than the core clock on current CPUs, so they're only
+    comparable on the same machine. Elsewhere they're left out.
+ */
+
+#include "Distortion.h"
+#include "DistortionDispatch.h"
+#include "ScopedFlushDenormals.h"
+#include "CommandLine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if DISTORTION_X86
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    /// How the nonlinearity is evaluated
+    struct Variant
+    {
+        const char* name;
+        Distortion::Accuracy accuracy;
+        Distortion::CurveTables curveTables;
+        Distortion::Antialiasing antialiasing;
+    };
+
+    const Variant variants[] = {
+        { "reference",    Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::noAntialiasing },
+        { "fast",         Distortion::fastAccuracy,      Distortion::noCurveTables,      Distortion::noAntialiasing },
+        { "linearTable",  Distortion::referenceAccuracy, Distortion::linearCurveTables,  Distortion::noAntialiasing },
+        { "hermiteTable", Distortion::referenceAccuracy, Distortion::hermiteCurveTables, Distortion::noAntialiasing },
+        { "adaa1",        Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::firstOrderAntialiasing },
+        { "adaa2",        Distortion::referenceAccuracy, Distortion::noCurveTables,      Distortion::secondOrderAntialiasing }
+    };
+
+    const char* const kernelSetNames[] = { "scalar", "sse2", "sse4.1", "avx2", "avx512" };
+
+    const double sampleRate = 48000.;
+
+    struct Settings
+    {
+        std::vector<std::string> kernelSets;
+        std::vector<std::string> variants;
+        std::vector<int> modes;
+        std::vector<int> blockSizes;
+        std::vector<float> drives;
+        int repetitions;
+        int samplesPerRun;
+        std::string outputPath;
+    };
+
+    /// The settings without any options, every case
+    Settings getDefaultSettings()
+    {
+        Settings settings;
+        for (const char* name : kernelSetNames) {
+            settings.kernelSets.push_back(name);
+        }
+        for (const Variant& variant : variants) {
+            settings.variants.push_back(variant.name);
+        }
+        for (int mode = 1; mode < Distortion::numModes; ++mode) {
+            settings.modes.push_back(mode);
+        }
+        for (int blockSize = 16; blockSize <= 4096; blockSize *= 2) {
+            settings.blockSizes.push_back(blockSize);
+        }
+        settings.drives = { 1.f, 4.f, 25.f };
+        settings.repetitions = 9;
+        settings.samplesPerRun = 32768;
+        return settings;
+    }
+
+    void printUsage()
+    {
+        std::fprintf(stderr,
+            "Usage: distortion-benchmark [options]\n"
+            "\n"
+            "  --quick              block sizes 64 and 512, drive 4, 5 repetitions\n"
+            "  --kernels LIST       kernel sets, e.g. scalar,avx2 (default: all supported)\n"
+            "  --variants LIST      reference, fast, linearTable, hermiteTable, adaa1, adaa2\n"
+            "  --modes LIST         modes, e.g. 2,8 (default: 1 to %d)\n"
+            "  --block-sizes LIST   block sizes (default: 16 to 4096 in powers of two)\n"
+            "  --drives LIST        drives (default: 1,4,25)\n"
+            "  --repetitions N      timed runs per case (default: 9)\n"
+            "  --samples N          samples processed per run (default: 32768)\n"
+            "  --output PATH        write the JSON there instead of to stdout\n",
+            Distortion::numModes - 1);
+    }
+
+    /// Parses the options over the defaults, returns false on a bad option
+    bool parseArguments(int argc, char* argv[], Settings& settings)
+    {
+        for (int i = 1; i < argc; ++i) {
+            const char* option = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (std::strcmp(option, "--quick") == 0) {
+                settings.blockSizes = { 64, 512 };
+                settings.drives = { 4.f };
+                settings.repetitions = 5;
+                continue;
+            }
+            if (value == nullptr) {
+                return false;
+            }
+            ++i;
+
+            if (std::strcmp(option, "--kernels") == 0) {
+                settings.kernelSets = CommandLine::split(value);
+            }
+            else if (std::strcmp(option, "--variants") == 0) {
+                settings.variants = CommandLine::split(value);
+            }
+            else if (std::strcmp(option, "--modes") == 0) {
+                settings.modes = CommandLine::splitNumbers<int>(value);
+            }
+            else if (std::strcmp(option, "--block-sizes") == 0) {
+                settings.blockSizes = CommandLine::splitNumbers<int>(value);
+            }
+            else if (std::strcmp(option, "--drives") == 0) {
+                settings.drives = CommandLine::splitNumbers<float>(value);
+            }
+            else if (std::strcmp(option, "--repetitions") == 0) {
+                settings.repetitions = std::max(std::atoi(value), 1);
+            }
+            else if (std::strcmp(option, "--samples") == 0) {
+                settings.samplesPerRun = std::max(std::atoi(value), 1);
+            }
+            else if (std::strcmp(option, "--output") == 0) {
+                settings.outputPath = value;
+            }
+            else {
+                return false;
+            }
+        }
+
+        for (int mode : settings.modes) {
+            if (mode < 0 || mode >= Distortion::numModes) {
+                return false;
+            }
+        }
+        for (int blockSize : settings.blockSizes) {
+            if (blockSize < 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Reads the cycle counter, 0 where there is none
+    inline unsigned long long readCycles()
+    {
+       #if DISTORTION_X86
+        return __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    const bool hasCycleCounter = DISTORTION_X86 != 0;
+
+    struct Statistics
+    {
+        double median;
+        // The median absolute deviation from the median
+        double mad;
+        double minimum;
+    };
+
+    double getMedian(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        const size_t middle = values.size() / 2;
+        return values.size() % 2 != 0 ? values[middle] : (values[middle - 1] + values[middle]) / 2.;
+    }
+
+    Statistics getStatistics(const std::vector<double>& runs)
+    {
+        Statistics statistics;
+        statistics.median = getMedian(runs);
+
+        std::vector<double> deviations;
+        for (double run : runs) {
+            deviations.push_back(std::fabs(run - statistics.median));
+        }
+        statistics.mad = getMedian(deviations);
+        statistics.minimum = *std::min_element(runs.begin(), runs.end());
+        return statistics;
+    }
+
+    /// The timings of one case, per sample
+    struct Measurement
+    {
+        std::vector<double> nanoseconds;
+        std::vector<double> cycles;
+    };
+
+    /// Times repetitions runs of a case after an untimed one, which also
+    /// lets a mode change settle
+    Measurement measure(const DistortionKernels::KernelSet& kernelSet, const Variant& variant,
+                        int mode, int blockSize, float drive, const Settings& settings,
+                        const std::vector<float>& input, std::vector<float>& output)
+    {
+        Distortion distortion;
+        distortion.controls.mode = mode;
+        distortion.controls.drive = drive;
+        distortion.controls.threshold = 0.5f;
+        distortion.controls.mix = 1.f;
+        distortion.prepare(sampleRate, blockSize, 1);
+        distortion.setKernelSet(kernelSet);
+        distortion.setAccuracy(variant.accuracy);
+        distortion.setCurveTables(variant.curveTables);
+        distortion.setAntialiasing(variant.antialiasing);
+        distortion.setSmoothing(ParameterSmoother::linear, 0.);
+        distortion.reset();
+
+        // Walk through the input so every block sees different samples
+        const int numBlocks = std::max(settings.samplesPerRun / blockSize, 1);
+        const int numOffsets = static_cast<int>(input.size()) - blockSize + 1;
+        const double numSamples = static_cast<double>(numBlocks) * blockSize;
+
+        Measurement measurement;
+        for (int run = -1; run < settings.repetitions; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            const unsigned long long startCycles = readCycles();
+
+            for (int block = 0; block < numBlocks; ++block) {
+                const int offset = static_cast<int>((static_cast<long long>(block) * blockSize) % numOffsets);
+                distortion.processBlock(0, input.data() + offset, output.data(), blockSize);
+            }
+
+            const unsigned long long cycles = readCycles() - startCycles;
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (run >= 0) {
+                measurement.nanoseconds.push_back(elapsed.count() / numSamples);
+                measurement.cycles.push_back(static_cast<double>(cycles) / numSamples);
+            }
+        }
+        return measurement;
+    }
+
+    void writeStatistics(std::FILE* file, const char* name, const std::vector<double>& runs)
+    {
+        const Statistics statistics = getStatistics(runs);
+        std::fprintf(file, "\"%s\": {\"median\": %.6g, \"mad\": %.6g, \"min\": %.6g, \"runs\": [",
+                     name, statistics.median, statistics.mad, statistics.minimum);
+        for (size_t i = 0; i < runs.size(); ++i) {
+            std::fprintf(file, "%s%.6g", i > 0 ? ", " : "", runs[i]);
+        }
+        std::fprintf(file, "]}");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings = getDefaultSettings();
+    if (!parseArguments(argc, argv, settings)) {
+        printUsage();
+        return 2;
+    }
+
+    std::FILE* file = stdout;
+    if (!settings.outputPath.empty()) {
+        file = std::fopen(settings.outputPath.c_str(), "w");
+        if (file == nullptr) {
+            std::fprintf(stderr, "Can't write %s\n", settings.outputPath.c_str());
+            return 1;
+        }
+    }
+
+    // Uniform noise in [-1, 1) from a fixed seed, twice the largest block
+    const int maximumBlockSize = *std::max_element(settings.blockSizes.begin(), settings.blockSizes.end());
+    std::vector<float> input(static_cast<size_t>(std::max(2 * maximumBlockSize, 8192)));
+    std::vector<float> output(static_cast<size_t>(maximumBlockSize));
+    unsigned int seed = 1;
+    for (float& sample : input) {
+        seed = seed * 1664525u + 1013904223u;
+        sample = static_cast<float>(seed >> 8) / 8388608.f - 1.f;
+    }
+
+    // As in the plugin
+    const ScopedFlushDenormals flushDenormals;
+
+    std::fprintf(file, "{\n");
+    std::fprintf(file, "  \"benchmark\": \"distortion\",\n");
+    std::fprintf(file, "  \"defaultKernelSet\": \"%s\",\n", DistortionKernels::selectKernelSet().name);
+    std::fprintf(file, "  \"cycleCounter\": %s,\n", hasCycleCounter ? "\"tsc\"" : "null");
+    std::fprintf(file, "  \"sampleRate\": %g,\n", sampleRate);
+    std::fprintf(file, "  \"repetitions\": %d,\n", settings.repetitions);
+    std::fprintf(file, "  \"samplesPerRun\": %d,\n", settings.samplesPerRun);
+    std::fprintf(file, "  \"results\": [");
+
+    bool first = true;
+    for (const std::string& kernelSetName : settings.kernelSets) {
+        const DistortionKernels::KernelSet* kernelSet = DistortionKernels::findKernelSet(kernelSetName.c_str());
+        if (kernelSet == nullptr) {
+            std::fprintf(stderr, "Skipping %s, not supported here\n", kernelSetName.c_str());
+            continue;
+        }
+        std::fprintf(stderr, "Measuring %s\n", kernelSet->name);
+
+        for (const Variant& variant : variants) {
+            if (std::find(settings.variants.begin(), settings.variants.end(), variant.name) == settings.variants.end()) {
+                continue;
+            }
+            for (int mode : settings.modes) {
+                for (int blockSize : settings.blockSizes) {
+                    for (float drive : settings.drives) {
+                        const Measurement measurement = measure(*kernelSet, variant, mode, blockSize, drive,
+                                                                settings, input, output);
+
+                        std::fprintf(file, "%s\n    {\"kernelSet\": \"%s\", \"variant\": \"%s\", \"mode\": %d, "
+                                     "\"blockSize\": %d, \"drive\": %g,\n     ",
+                                     first ? "" : ",", kernelSet->name, variant.name, mode, blockSize, drive);
+                        writeStatistics(file, "nsPerSample", measurement.nanoseconds);
+                        std::fprintf(file, ",\n     ");
+                        if (hasCycleCounter) {
+                            writeStatistics(file, "cyclesPerSample", measurement.cycles);
+                        }
+                        else {
+                            std::fprintf(file, "\"cyclesPerSample\": null");
+                        }
+                        std::fprintf(file, "}");
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+
+    std::fprintf(file, "\n  ]\n}\n");
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    return 0;
+}
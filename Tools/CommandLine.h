@@ -0,0 +1,47 @@
+#ifndef COMMANDLINE_H_INCLUDED
+#define COMMANDLINE_H_INCLUDED
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+    Option parsing shared by the command line tools.
+ */
+namespace CommandLine
+{
+    /// Splits a comma separated list, skipping empty items
+    inline std::vector<std::string> split(const char* list)
+    {
+        std::vector<std::string> items;
+        std::string item;
+        for (const char* c = list; ; ++c) {
+            if (*c == ',' || *c == '\0') {
+                if (!item.empty()) {
+                    items.push_back(item);
+                }
+                item.clear();
+                if (*c == '\0') {
+                    break;
+                }
+            }
+            else {
+                item += *c;
+            }
+        }
+        return items;
+    }
+
+    /// Splits a comma separated list of numbers
+    template <typename T>
+    std::vector<T> splitNumbers(const char* list)
+    {
+        std::vector<T> numbers;
+        for (const std::string& item : split(list)) {
+            numbers.push_back(static_cast<T>(std::atof(item.c_str())));
+        }
+        return numbers;
+    }
+}
+
+#endif  // COMMANDLINE_H_INCLUDED
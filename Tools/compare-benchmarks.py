@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Compares two distortion-benchmark results files, see readme.md.
+
+A case is a kernel set, variant, mode, block size and drive. The change of
+a case is the relative change of its median time per sample, or 0 when it's
+within the noise of both runs. The noise is the median absolute deviation of
+their repetitions, scaled to a standard deviation and multiplied by the
+noise factor.
+
+A kernel, a kernel set, variant and mode, has regressed when the median
+change of its cases exceeds the threshold percentage. Single cases are too
+noisy to gate on, as the repetitions of a case run back to back and miss
+the drift between runs.
+
+Prints a report per kernel and exits with 1 if any kernel regressed, 0
+otherwise. Cases in only one of the files are listed but don't fail.
+"""
+
+import argparse
+import json
+import sys
+
+# Scales a median absolute deviation to the standard deviation of a normal
+# distribution
+MAD_TO_SIGMA = 1.4826
+
+METRICS = {
+    'ns': 'nsPerSample',
+    'cycles': 'cyclesPerSample',
+}
+
+
+def median(values):
+    values = sorted(values)
+    middle = len(values) // 2
+    if len(values) % 2:
+        return values[middle]
+    return (values[middle - 1] + values[middle]) / 2.
+
+
+def get_statistics(timing):
+    """Returns the median and MAD of a timing, from its runs if it has any"""
+    runs = timing.get('runs')
+    if runs:
+        centre = median(runs)
+        return centre, median([abs(run - centre) for run in runs])
+    return timing['median'], timing.get('mad', 0.)
+
+
+def load(path, metric):
+    """Returns the timings of a results file by case"""
+    with open(path) as file:
+        results = json.load(file)
+
+    cases = {}
+    for result in results['results']:
+        timing = result.get(METRICS[metric])
+        if timing is None:
+            continue
+        key = (result['kernelSet'], result['variant'], result['mode'],
+               result['blockSize'], result['drive'])
+        cases[key] = get_statistics(timing)
+    return cases
+
+
+def compare(baseline, current, noise_factor):
+    """Returns the relative change of every case in both and whether it's
+    past the noise, grouped by kernel"""
+    kernels = {}
+    for key in sorted(baseline.keys() & current.keys()):
+        base_median, base_mad = baseline[key]
+        current_median, current_mad = current[key]
+        if base_median <= 0.:
+            continue
+
+        delta = current_median - base_median
+        noise = noise_factor * MAD_TO_SIGMA * (base_mad + current_mad)
+        kernels.setdefault(key[:3], []).append((key, delta / base_median, abs(delta) > noise))
+    return kernels
+
+
+def report(kernels, baseline, current, threshold, verbose):
+    """Prints the median and worst change per kernel, then the cases of the
+    regressed kernels. Returns the number of regressed kernels."""
+    print('%-8s %-13s %4s  %9s  %9s'
+          % ('kernels', 'variant', 'mode', 'median', 'worst'))
+
+    regressions = []
+    for kernel in sorted(kernels):
+        changes = [change if significant else 0.
+                   for _, change, significant in kernels[kernel]]
+        change = median(changes)
+        regressed = change > threshold / 100.
+        if regressed:
+            regressions.append(kernel)
+        if regressed or verbose:
+            print('%-8s %-13s %4d  %+8.1f%%  %+8.1f%%%s'
+                  % (kernel + (100. * change, 100. * max(changes),
+                               '  regressed' if regressed else '')))
+
+    if regressions:
+        print('\nCases of the kernels regressed past %g%%:' % threshold)
+        for kernel in regressions:
+            for key, change, significant in kernels[kernel]:
+                print('  %s %s mode %d, block size %d, drive %g: %.4g -> %.4g (%+.1f%%%s)'
+                      % (key + (baseline[key][0], current[key][0], 100. * change,
+                                '' if significant else ', noise')))
+
+    for name, cases, others in (('baseline', baseline, current),
+                                ('current run', current, baseline)):
+        missing = sorted(cases.keys() - others.keys())
+        if missing:
+            print('\n%d cases only in the %s, e.g. %s %s mode %d, block size %d, drive %g'
+                  % ((len(missing), name) + missing[0]))
+
+    print('\n%d of %d kernels regressed' % (len(regressions), len(kernels)))
+    return len(regressions)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compares distortion-benchmark results against a baseline.')
+    parser.add_argument('baseline', help='the results to compare against')
+    parser.add_argument('current', help='the results of the current build')
+    parser.add_argument('--threshold', type=float, default=5.,
+                        help='the median slowdown in percent a kernel may '
+                             'have (default: 5)')
+    parser.add_argument('--noise', type=float, default=3.,
+                        help='changes of a case within this many standard '
+                             'deviations of both runs, estimated from their '
+                             'MAD, count as none (default: 3)')
+    parser.add_argument('--metric', choices=sorted(METRICS), default='ns',
+                        help='compare nanoseconds or cycles per sample (default: ns)')
+    parser.add_argument('--verbose', action='store_true',
+                        help='list every kernel, not only the regressed ones')
+    arguments = parser.parse_args()
+
+    baseline = load(arguments.baseline, arguments.metric)
+    current = load(arguments.current, arguments.metric)
+    kernels = compare(baseline, current, arguments.noise)
+    if not kernels:
+        print('No cases in common')
+        return 1
+
+    regressions = report(kernels, baseline, current, arguments.threshold,
+                         arguments.verbose)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())